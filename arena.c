@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+#include "log.h"
+#define ARENA_ALIGNMENT 16
+
+static size_t align_up(size_t size) {
+	return (size + (ARENA_ALIGNMENT - 1)) & ~((size_t) ARENA_ALIGNMENT - 1);
+}
+
+static struct ArenaChunk* arena_chunk_create(size_t capacity) {
+	struct ArenaChunk *chunk = malloc(sizeof(struct ArenaChunk) + capacity);
+	if (chunk == NULL) {
+		LOG_ERROR("Failed to allocate an arena chunk of %zu bytes.\n", capacity);
+		return NULL;
+	}
+
+	chunk->next = NULL;
+	chunk->used = 0;
+	chunk->capacity = capacity;
+	return chunk;
+}
+
+struct Arena* arena_create(size_t chunk_size) {
+	if (chunk_size == 0)
+		chunk_size = ARENA_DEFAULT_CHUNK_SIZE;
+
+	struct Arena *arena = malloc(sizeof(struct Arena));
+	if (arena == NULL) {
+		LOG_ERROR("Failed to allocate the arena.\n");
+		return NULL;
+	}
+
+	arena->chunk_size = align_up(chunk_size);
+	arena->first = arena_chunk_create(arena->chunk_size);
+	if (arena->first == NULL) {
+		free(arena);
+		return NULL;
+	}
+
+	arena->current = arena->first;
+	arena->last_allocation = NULL;
+	arena->last_allocation_size = 0;
+	arena->bytes_allocated = 0;
+	return arena;
+}
+
+void arena_destroy(struct Arena *arena) {
+	if (arena == NULL) {
+		LOG_ERROR("Provided argument `struct Arena *arena` is a NULL pointer.\n");
+		return;
+	}
+
+	struct ArenaChunk *chunk = arena->first;
+	struct ArenaChunk *next;
+	while (chunk != NULL) {
+		next = chunk->next;
+		free(chunk);
+		chunk = next;
+	}
+
+	free(arena);
+}
+
+void arena_reset(struct Arena *arena) {
+	if (arena == NULL) {
+		LOG_ERROR("Provided argument `struct Arena *arena` is a NULL pointer.\n");
+		return;
+	}
+
+	// Only the first chunk is rewound here. Later chunks are rewound
+	// when arena_alloc() moves on to them, so a reset does not depend on
+	// how many chunks were used.
+	arena->current = arena->first;
+	arena->first->used = 0;
+	arena->last_allocation = NULL;
+	arena->last_allocation_size = 0;
+	arena->bytes_allocated = 0;
+}
+
+void* arena_alloc(struct Arena *arena, size_t size) {
+	if (arena == NULL) {
+		LOG_ERROR("Provided argument `struct Arena *arena` is a NULL pointer.\n");
+		return NULL;
+	}
+
+	size = align_up(size);
+	struct ArenaChunk *chunk = arena->current;
+
+	// Case 1: The request does not fit in the current chunk. Move on to
+	//         the next chunk that was kept from before a reset, or create
+	//         a new one. Requests larger than the chunk size get a chunk of
+	//         their own.
+	while (chunk->capacity - chunk->used < size) {
+		if (chunk->next != NULL) {
+			chunk = chunk->next;
+			chunk->used = 0;
+			continue;
+		}
+
+		size_t capacity = (size > arena->chunk_size) ? size : arena->chunk_size;
+		chunk->next = arena_chunk_create(capacity);
+		if (chunk->next == NULL)
+			return NULL;
+
+		chunk = chunk->next;
+	}
+
+	// Case 2: Bump the pointer.
+	void *pointer = chunk->data + chunk->used;
+	chunk->used += size;
+	arena->current = chunk;
+	arena->last_allocation = pointer;
+	arena->last_allocation_size = size;
+	arena->bytes_allocated += size;
+	return pointer;
+}
+
+void* arena_grow(struct Arena *arena, void *pointer, size_t old_size, size_t new_size) {
+	if (arena == NULL) {
+		LOG_ERROR("Provided argument `struct Arena *arena` is a NULL pointer.\n");
+		return NULL;
+	}
+
+	if (pointer == NULL)
+		return arena_alloc(arena, new_size);
+
+	// Case 1: This is the most recent allocation, so it can be extended
+	//         in place if the chunk still has room.
+	struct ArenaChunk *chunk = arena->current;
+	if (pointer == arena->last_allocation) {
+		size_t start = (size_t) ((unsigned char*) pointer - chunk->data);
+		size_t aligned = align_up(new_size);
+		if (start + aligned <= chunk->capacity) {
+			arena->bytes_allocated += aligned - arena->last_allocation_size;
+			chunk->used = start + aligned;
+			arena->last_allocation_size = aligned;
+			return pointer;
+		}
+	}
+
+	// Case 2: Copy into a fresh allocation.
+	void *grown = arena_alloc(arena, new_size);
+	if (grown == NULL)
+		return NULL;
+
+	memcpy(grown, pointer, (old_size < new_size) ? old_size : new_size);
+	return grown;
+}
@@ -0,0 +1,43 @@
+#ifndef ARENA_H
+#define ARENA_H
+#include <stddef.h>
+#define ARENA_DEFAULT_CHUNK_SIZE (1024 * 1024)
+
+// A bump allocator. Memory is handed out from large chunks and is never 
+// freed individually: arena_reset() makes all of it reusable at once and 
+// arena_destroy() gives it back to the system.
+struct ArenaChunk {
+	struct ArenaChunk *next;
+	size_t used;
+	size_t capacity;
+	unsigned char data[];
+};
+
+struct Arena {
+	struct ArenaChunk *first;
+	struct ArenaChunk *current;
+	size_t chunk_size;
+
+	// Most recent allocation, which arena_grow() can extend in place
+	void  *last_allocation;
+	size_t last_allocation_size;
+
+	// Bytes handed out since creation or the last reset
+	size_t bytes_allocated;
+};
+
+// Pass 0 for `chunk_size` to use ARENA_DEFAULT_CHUNK_SIZE
+struct Arena* arena_create(size_t chunk_size);
+void arena_destroy(struct Arena *arena);
+
+// Rewinds the arena so its chunks can be reused. Everything previously 
+// allocated from it becomes invalid.
+void arena_reset(struct Arena *arena);
+
+void* arena_alloc(struct Arena *arena, size_t size);
+
+// Resizes an allocation. If `pointer` is the arena's most recent allocation
+// and the chunk has room, it is extended in place; otherwise the contents 
+// are copied to a new allocation (the old space is reclaimed on reset).
+void* arena_grow(struct Arena *arena, void *pointer, size_t old_size, size_t new_size);
+#endif
@@ -0,0 +1,542 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "batch.h"
+#include "arena.h"
+#include "source.h"
+#include "stats.h"
+#include "tokenizer.h"
+#include "writer.h"
+#include "lines.h"
+#include "log.h"
+
+// Output of one file, handed from the thread that tokenized it to the
+// thread writing everything out in order. Warnings about numeric literals
+// that do not fit go to stderr then, so they come in the same order.
+struct BatchResult {
+	char *output;
+	size_t output_length;
+	char *warnings;
+	size_t warnings_length;
+	bool done;
+	bool failed;
+};
+
+// Indices of the files a thread still has to do. The owner takes them from
+// the front (lowest index first, which is what the writer waits for),
+// thieves take them from the back.
+struct BatchQueue {
+	pthread_mutex_t lock;
+	size_t *items;
+	size_t head;
+	size_t tail;
+};
+
+struct Batch;
+
+// One thread of the pool and everything it reuses from file to file
+struct BatchWorker {
+	struct Batch *batch;
+	size_t id;
+	struct BatchQueue queue;
+	struct Arena *arena;
+	struct Writer *writer;
+	char *buffer;
+	size_t buffer_capacity;
+	bool collect_stats;
+	struct TokenizerStats stats;
+	pthread_t thread;
+	bool started;
+};
+
+struct Batch {
+	const struct BatchPaths *paths;
+	const struct TokenSpec *spec;
+	struct BatchResult *results;
+	struct BatchWorker *workers;
+	size_t workers_length;
+	pthread_mutex_t lock;
+	pthread_cond_t finished;
+};
+
+void batch_paths_init(struct BatchPaths *paths) {
+	if (paths == NULL) {
+		LOG_ERROR("Provided argument `struct BatchPaths *paths` is a NULL pointer.\n");
+		return;
+	}
+
+	paths->paths = NULL;
+	paths->length = 0;
+	paths->capacity = 0;
+}
+
+void batch_paths_destroy(struct BatchPaths *paths) {
+	if (paths == NULL) {
+		LOG_ERROR("Provided argument `struct BatchPaths *paths` is a NULL pointer.\n");
+		return;
+	}
+
+	for (size_t i = 0; i < paths->length; i++)
+		free(paths->paths[i]);
+	free(paths->paths);
+	batch_paths_init(paths);
+}
+
+int batch_paths_add(struct BatchPaths *paths, const char *path) {
+	if (paths == NULL) {
+		LOG_ERROR("Provided argument `struct BatchPaths *paths` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (path == NULL) {
+		LOG_ERROR("Provided argument `const char *path` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (paths->length == paths->capacity) {
+		size_t new_capacity = (paths->capacity == 0) ? 64 : paths->capacity * 2;
+		char **realloc_pointer = realloc(paths->paths, sizeof(char*) * new_capacity);
+		if (realloc_pointer == NULL) {
+			LOG_ERROR("Failed to grow the paths list to %zu entries.\n", new_capacity);
+			return EXIT_FAILURE;
+		}
+
+		paths->paths = realloc_pointer;
+		paths->capacity = new_capacity;
+	}
+
+	char *copy = strdup(path);
+	if (copy == NULL) {
+		LOG_ERROR("Failed to copy the path \"%s\".\n", path);
+		return EXIT_FAILURE;
+	}
+
+	paths->paths[paths->length] = copy;
+	paths->length++;
+	return EXIT_SUCCESS;
+}
+
+int batch_paths_add_manifest(struct BatchPaths *paths, const char *manifest) {
+	if (manifest == NULL) {
+		LOG_ERROR("Provided argument `const char *manifest` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	FILE *file = (strcmp(manifest, "-") == 0) ? stdin : fopen(manifest, "r");
+	if (file == NULL) {
+		LOG_ERROR("Failed to open the manifest \"%s\": %s.\n", manifest, strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	int status = EXIT_SUCCESS;
+	char *line = NULL;
+	size_t line_capacity = 0;
+	ssize_t line_length;
+	while ((line_length = getline(&line, &line_capacity, file)) >= 0) {
+		while (line_length > 0 && (line[line_length - 1] == '\n' || line[line_length - 1] == '\r'))
+			line_length--;
+		line[line_length] = '\0';
+
+		if (line_length == 0 || line[0] == '#')
+			continue;
+
+		if (batch_paths_add(paths, line) == EXIT_FAILURE) {
+			status = EXIT_FAILURE;
+			break;
+		}
+	}
+
+	free(line);
+	if (file != stdin)
+		fclose(file);
+	return status;
+}
+
+static int batch_compare_names(const void *a, const void *b) {
+	return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+int batch_paths_add_directory(struct BatchPaths *paths, const char *directory) {
+	if (directory == NULL) {
+		LOG_ERROR("Provided argument `const char *directory` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	DIR *stream = opendir(directory);
+	if (stream == NULL) {
+		LOG_ERROR("Failed to open the directory \"%s\": %s.\n", directory, strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	// Read the whole directory first so the entries can be sorted
+	struct BatchPaths names;
+	batch_paths_init(&names);
+	int status = EXIT_SUCCESS;
+	struct dirent *entry;
+	while ((entry = readdir(stream)) != NULL) {
+		if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+			continue;
+
+		if (batch_paths_add(&names, entry->d_name) == EXIT_FAILURE) {
+			status = EXIT_FAILURE;
+			break;
+		}
+	}
+	closedir(stream);
+
+	if (names.length > 0)
+		qsort(names.paths, names.length, sizeof(char*), batch_compare_names);
+
+	size_t directory_length = strlen(directory);
+	bool has_separator = (directory_length > 0 && directory[directory_length - 1] == '/');
+	for (size_t i = 0; i < names.length && status == EXIT_SUCCESS; i++) {
+		size_t path_size = directory_length + 1 + strlen(names.paths[i]) + 1;
+		char *path = malloc(path_size);
+		if (path == NULL) {
+			LOG_ERROR("Failed to allocate %zu bytes for a path.\n", path_size);
+			status = EXIT_FAILURE;
+			break;
+		}
+		snprintf(path, path_size, has_separator ? "%s%s" : "%s/%s", directory, names.paths[i]);
+
+		struct stat info;
+		if (lstat(path, &info) != 0)
+			LOG_INFO("Skipping \"%s\": %s.\n", path, strerror(errno));
+		else if (S_ISDIR(info.st_mode))
+			status = batch_paths_add_directory(paths, path);
+		else if (S_ISREG(info.st_mode))
+			status = batch_paths_add(paths, path);
+
+		free(path);
+	}
+
+	batch_paths_destroy(&names);
+	return status;
+}
+
+// Reads a file into `source`. Small regular files go into the worker's
+// read buffer, which is reused for the next file (`borrowed` is then set
+// and the source must not be closed); anything else is opened as usual.
+static int batch_read(struct BatchWorker *worker, const char *path, struct Source *source, bool *borrowed) {
+	(*borrowed) = false;
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		LOG_ERROR("Failed to open \"%s\": %s.\n", path, strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || ! S_ISREG(info.st_mode) || info.st_size == 0 || info.st_size > BATCH_READ_LIMIT) {
+		int status = source_open_fd(fd, source);
+		close(fd);
+		return status;
+	}
+
+	size_t size = (size_t) info.st_size;
+	if (size > worker->buffer_capacity) {
+		char *realloc_pointer = realloc(worker->buffer, size);
+		if (realloc_pointer == NULL) {
+			LOG_ERROR("Failed to grow the read buffer to %zu bytes.\n", size);
+			close(fd);
+			return EXIT_FAILURE;
+		}
+
+		worker->buffer = realloc_pointer;
+		worker->buffer_capacity = size;
+	}
+
+	// The file may shrink while it is read; whatever was there is used
+	size_t length = 0;
+	while (length < size) {
+		ssize_t bytes_read = read(fd, worker->buffer + length, size - length);
+		if (bytes_read < 0) {
+			if (errno == EINTR)
+				continue;
+
+			LOG_ERROR("Failed to read \"%s\": %s.\n", path, strerror(errno));
+			close(fd);
+			return EXIT_FAILURE;
+		}
+
+		if (bytes_read == 0)
+			break;
+
+		length += (size_t) bytes_read;
+	}
+	close(fd);
+
+	source->data = worker->buffer;
+	source->length = length;
+	source->mapped = false;
+	(*borrowed) = true;
+	return EXIT_SUCCESS;
+}
+
+static void batch_process(struct BatchWorker *worker, size_t index) {
+	struct Batch *batch = worker->batch;
+	const char *path = batch->paths->paths[index];
+	struct BatchResult *result = &(batch->results[index]);
+
+	struct Source source;
+	source.data = NULL;
+	source.length = 0;
+	bool borrowed = false;
+	struct StatsTimer timer;
+	stats_timer_start(&timer);
+	int status = batch_read(worker, path, &source, &borrowed);
+	stats_timer_stop(&timer, STATS_PHASE_READ);
+	bool opened = (status == EXIT_SUCCESS && ! borrowed);
+
+	// An empty file is fine, it just has no tokens
+	struct Token *tokens = NULL;
+	size_t tokens_length = 0;
+	if (status == EXIT_SUCCESS && source.length > 0) {
+		arena_reset(worker->arena);
+		if (worker->batch->spec != NULL)
+			tokens = tokenize_with_spec(worker->batch->spec, worker->arena, source.data, source.length, &tokens_length, NULL);
+		else
+			tokens = tokenize_arena(worker->arena, source.data, source.length, &tokens_length);
+		if (tokens == NULL)
+			status = EXIT_FAILURE;
+	}
+
+	// Formatted into the worker's memory writer, whose buffer then moves 
+	// over to the result
+	if (status == EXIT_SUCCESS)
+		status = writer_file(worker->writer, path);
+
+	// The line index (and the warnings stream) are only set up for files
+	// that need them
+	struct LineIndex lines;
+	FILE *warnings = NULL;
+	line_index_init(&lines, source.data, source.length);
+	for (size_t i = 0; i < tokens_length && status == EXIT_SUCCESS; i++) {
+		status = writer_token(worker->writer, &(tokens[i]), source.data);
+		if (! tokens[i].metadata.numeric_overflow || status == EXIT_FAILURE)
+			continue;
+
+		if (warnings == NULL)
+			warnings = open_memstream(&(result->warnings), &(result->warnings_length));
+		if (warnings == NULL) {
+			LOG_ERROR("Failed to set up the warnings of \"%s\".\n", path);
+			status = EXIT_FAILURE;
+			break;
+		}
+		line_index_report_overflow(&lines, warnings, path, &(tokens[i]));
+	}
+	line_index_destroy(&lines);
+	if (warnings != NULL && fclose(warnings) != 0)
+		status = EXIT_FAILURE;
+
+	if (status == EXIT_SUCCESS)
+		status = writer_take(worker->writer, &(result->output), &(result->output_length));
+	else {
+		char *partial;
+		size_t partial_length;
+		if (writer_take(worker->writer, &partial, &partial_length) == EXIT_SUCCESS)
+			free(partial);
+	}
+
+	if (opened)
+		source_close(&source);
+
+	pthread_mutex_lock(&(batch->lock));
+	result->failed = (status == EXIT_FAILURE);
+	result->done = true;
+	pthread_cond_broadcast(&(batch->finished));
+	pthread_mutex_unlock(&(batch->lock));
+}
+
+// Next file for `worker`: its own oldest one, or else the newest one of
+// the first other worker that has any left
+static bool batch_take(struct BatchWorker *worker, size_t *index) {
+	struct BatchQueue *queue = &(worker->queue);
+	pthread_mutex_lock(&(queue->lock));
+	bool found = (queue->head < queue->tail);
+	if (found) {
+		(*index) = queue->items[queue->head];
+		queue->head++;
+	}
+	pthread_mutex_unlock(&(queue->lock));
+	if (found)
+		return true;
+
+	struct Batch *batch = worker->batch;
+	for (size_t i = 1; i < batch->workers_length; i++) {
+		struct BatchQueue *victim = &(batch->workers[(worker->id + i) % batch->workers_length].queue);
+		pthread_mutex_lock(&(victim->lock));
+		found = (victim->head < victim->tail);
+		if (found) {
+			victim->tail--;
+			(*index) = victim->items[victim->tail];
+		}
+		pthread_mutex_unlock(&(victim->lock));
+		if (found)
+			return true;
+	}
+
+	return false;
+}
+
+static void* batch_worker_run(void *argument) {
+	struct BatchWorker *worker = (struct BatchWorker*) argument;
+	struct TokenizerStats *previous_stats = NULL;
+	if (worker->collect_stats)
+		previous_stats = stats_attach(&(worker->stats));
+
+	size_t index;
+	while (batch_take(worker, &index))
+		batch_process(worker, index);
+
+	if (worker->collect_stats)
+		stats_attach(previous_stats);
+	return NULL;
+}
+
+static void batch_workers_destroy(struct BatchWorker *workers, size_t length) {
+	for (size_t i = 0; i < length; i++) {
+		pthread_mutex_destroy(&(workers[i].queue.lock));
+		free(workers[i].queue.items);
+		if (workers[i].arena != NULL)
+			arena_destroy(workers[i].arena);
+		if (workers[i].writer != NULL)
+			writer_destroy(workers[i].writer);
+		free(workers[i].buffer);
+	}
+	free(workers);
+}
+
+int batch_tokenize(const struct BatchPaths *paths, size_t threads, const struct TokenSpec *spec, struct Writer *output) {
+	if (paths == NULL) {
+		LOG_ERROR("Provided argument `const struct BatchPaths *paths` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (output == NULL) {
+		LOG_ERROR("Provided argument `struct Writer *output` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (paths->length == 0)
+		return EXIT_SUCCESS;
+
+	if (threads == 0) {
+		long online = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = (online > 0) ? (size_t) online : 1;
+	}
+
+	// No point in threads that would never get a block of their own
+	size_t blocks = (paths->length + BATCH_DEAL_BLOCK - 1) / BATCH_DEAL_BLOCK;
+	if (threads > blocks)
+		threads = blocks;
+
+	struct Batch batch;
+	batch.paths = paths;
+	batch.spec = spec;
+	batch.workers_length = threads;
+	batch.results = calloc(paths->length, sizeof(struct BatchResult));
+	batch.workers = calloc(threads, sizeof(struct BatchWorker));
+	if (batch.results == NULL || batch.workers == NULL) {
+		LOG_ERROR("Failed to allocate a batch of %zu files on %zu threads.\n", paths->length, threads);
+		free(batch.results);
+		free(batch.workers);
+		return EXIT_FAILURE;
+	}
+
+	// Deal the files out in blocks, round robin, so every queue holds
+	// increasing indices and the files finish roughly in output order
+	struct TokenizerStats *caller_stats = stats_current;
+	for (size_t i = 0; i < threads; i++) {
+		struct BatchWorker *worker = &(batch.workers[i]);
+		worker->batch = &batch;
+		worker->id = i;
+		worker->collect_stats = (caller_stats != NULL);
+		stats_reset(&(worker->stats));
+		pthread_mutex_init(&(worker->queue.lock), NULL);
+
+		size_t count = 0;
+		for (size_t block = i; block < blocks; block += threads)
+			count += (block == blocks - 1) ? paths->length - block * BATCH_DEAL_BLOCK : BATCH_DEAL_BLOCK;
+
+		worker->queue.items = malloc(sizeof(size_t) * count);
+		worker->arena = arena_create(0);
+		worker->writer = writer_create_memory(output->format);
+		if (worker->queue.items == NULL || worker->arena == NULL || worker->writer == NULL) {
+			LOG_ERROR("Failed to set up batch thread %zu.\n", i);
+			batch_workers_destroy(batch.workers, i + 1);
+			free(batch.results);
+			return EXIT_FAILURE;
+		}
+
+		for (size_t block = i; block < blocks; block += threads) {
+			size_t end = (block + 1) * BATCH_DEAL_BLOCK;
+			if (end > paths->length)
+				end = paths->length;
+
+			for (size_t index = block * BATCH_DEAL_BLOCK; index < end; index++)
+				worker->queue.items[worker->queue.tail++] = index;
+		}
+	}
+
+	pthread_mutex_init(&(batch.lock), NULL);
+	pthread_cond_init(&(batch.finished), NULL);
+
+	// The files of a thread that couldn't be started get stolen by the
+	// others. If none could, this thread does all of them before writing.
+	size_t started = 0;
+	for (size_t i = 0; i < threads; i++) {
+		batch.workers[i].started = (pthread_create(&(batch.workers[i].thread), NULL, batch_worker_run, &(batch.workers[i])) == 0);
+		if (batch.workers[i].started)
+			started++;
+	}
+
+	if (started == 0)
+		batch_worker_run(&(batch.workers[0]));
+
+	// Write the results out in order as they come in
+	int status = EXIT_SUCCESS;
+	for (size_t i = 0; i < paths->length; i++) {
+		struct BatchResult *result = &(batch.results[i]);
+		pthread_mutex_lock(&(batch.lock));
+		while (! result->done)
+			pthread_cond_wait(&(batch.finished), &(batch.lock));
+		pthread_mutex_unlock(&(batch.lock));
+
+		if (result->warnings != NULL)
+			fwrite(result->warnings, 1, result->warnings_length, stderr);
+
+		if (result->failed) {
+			fprintf(stderr, "Failed to tokenize \"%s\".\n", paths->paths[i]);
+			status = EXIT_FAILURE;
+		}
+		else if (writer_write(output, result->output, result->output_length) == EXIT_FAILURE) {
+			LOG_ERROR("Failed to write the tokens of \"%s\".\n", paths->paths[i]);
+			status = EXIT_FAILURE;
+		}
+
+		free(result->output);
+		result->output = NULL;
+		free(result->warnings);
+		result->warnings = NULL;
+	}
+
+	for (size_t i = 0; i < threads; i++) {
+		if (batch.workers[i].started)
+			pthread_join(batch.workers[i].thread, NULL);
+
+		if (caller_stats != NULL)
+			stats_merge(caller_stats, &(batch.workers[i].stats));
+	}
+
+	pthread_cond_destroy(&(batch.finished));
+	pthread_mutex_destroy(&(batch.lock));
+	batch_workers_destroy(batch.workers, threads);
+	free(batch.results);
+	return status;
+}
@@ -0,0 +1,44 @@
+#ifndef BATCH_H
+#define BATCH_H
+#include <stddef.h>
+#include "writer.h"
+#define BATCH_DEAL_BLOCK 8
+#define BATCH_READ_LIMIT (1024 * 1024)
+
+// A list of input paths. The strings are owned by the list.
+struct BatchPaths {
+	char **paths;
+	size_t length;
+	size_t capacity;
+};
+
+void batch_paths_init(struct BatchPaths *paths);
+void batch_paths_destroy(struct BatchPaths *paths);
+int batch_paths_add(struct BatchPaths *paths, const char *path);
+
+// Adds every line of `manifest` ("-" for standard input) as a path. Empty
+// lines and lines starting with '#' are skipped.
+int batch_paths_add_manifest(struct BatchPaths *paths, const char *manifest);
+
+// Adds every regular file under `directory`, recursively. Entries are
+// sorted by name within each directory so the order does not depend on
+// the file system. Symbolic links are not followed.
+int batch_paths_add_directory(struct BatchPaths *paths, const char *directory);
+
+// Tokenizes every file on a pool of `threads` threads (0 means one per
+// CPU) and writes the tokens of each to `output`, after a writer_file()
+// marker, in the order of `paths` no matter which thread finished first.
+//
+// Files are dealt out to the threads in blocks up front; a thread that
+// runs out steals from the back of another's queue. Each thread keeps one
+// arena, one read buffer and one memory writer (in the format of `output`)
+// for all of its files, so small files cost no allocations beyond their
+// output.
+//
+// Files are tokenized by the rules of `spec`, or the built-in ones if it
+// is NULL. Numeric literals that do not fit are warned about on stderr
+// (as "path:line:column: ..."), with each file's warnings written when its
+// tokens are. Files that fail are reported on stderr and skipped. Returns 
+// EXIT_FAILURE if any did.
+int batch_tokenize(const struct BatchPaths *paths, size_t threads, const struct TokenSpec *spec, struct Writer *output);
+#endif
@@ -0,0 +1,448 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "tokenizer.h"
+#include "source.h"
+
+// Benchmarks for the tokenizer. Each phase reports its throughput, how many
+// times it called malloc(), calloc() or realloc(), and the process' peak
+// resident set size once it is done (which only ever grows).
+//
+// Allocations are counted by linking with -Wl,--wrap=malloc (and likewise
+// for calloc and realloc), which the "bench" build target does.
+
+static size_t allocations = 0;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void *pointer, size_t size);
+
+void* __wrap_malloc(size_t size) {
+	allocations++;
+	return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+	allocations++;
+	return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void *pointer, size_t size) {
+	allocations++;
+	return __real_realloc(pointer, size);
+}
+
+enum CorpusMix {
+	CORPUS_MIX_DEFAULT,
+	CORPUS_MIX_ARITHMETIC,
+	CORPUS_MIX_STRINGS,
+	CORPUS_MIX_ESCAPES
+};
+
+struct Corpus {
+	char *data;
+	size_t length;
+	size_t capacity;
+	uint64_t random;
+};
+
+struct Measurement {
+	double seconds;
+	size_t bytes;
+	size_t tokens;
+	size_t allocations;
+};
+
+void print_usage() {
+	printf("Usage: bench [--size BYTES[K|M|G]] [--mix default|arithmetic|strings|escapes] [--seed N] [--iterations N] [--file PATH]\n");
+}
+
+static double now(void) {
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return (double) time.tv_sec + (double) time.tv_nsec / 1e9;
+}
+
+static long peak_rss_kilobytes(void) {
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
+
+// xorshift64, so a seed always gives the same corpus
+static uint64_t corpus_random(struct Corpus *corpus, uint64_t bound) {
+	corpus->random ^= corpus->random << 13;
+	corpus->random ^= corpus->random >> 7;
+	corpus->random ^= corpus->random << 17;
+	return corpus->random % bound;
+}
+
+static void corpus_append(struct Corpus *corpus, const char *text, size_t length) {
+	if (corpus->length + length > corpus->capacity)
+		length = corpus->capacity - corpus->length;
+
+	memcpy(corpus->data + corpus->length, text, length);
+	corpus->length += length;
+}
+
+static void corpus_appendf(struct Corpus *corpus, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+static void corpus_appendf(struct Corpus *corpus, const char *format, ...) {
+	char line[256];
+	va_list arguments;
+	va_start(arguments, format);
+	int length = vsnprintf(line, sizeof(line), format, arguments);
+	va_end(arguments);
+	if (length > 0)
+		corpus_append(corpus, line, ((size_t) length < sizeof(line)) ? (size_t) length : sizeof(line) - 1);
+}
+
+static const char *words[] = {
+	"Jello", "Boxes", "Vodka", "Hot", "Cold", "water", "yield", "Sugar",
+	"Flour", "Eggs", "Butter", "Milk", "Salt", "Yeast", "Oven", "Tray"
+};
+#define WORDS_COUNT (sizeof(words) / sizeof(words[0]))
+
+// int   field "Jello Boxes"
+static void corpus_field(struct Corpus *corpus) {
+	static const char *types[] = { "int  ", "float", "string" };
+	corpus_appendf(corpus, "%s field \"%s %s\"\n", types[corpus_random(corpus, 3)], words[corpus_random(corpus, WORDS_COUNT)], words[corpus_random(corpus, WORDS_COUNT)]);
+}
+
+// constrain on "Jello Boxes" size is (13 + 12 * (4.5 - 2))
+static void corpus_constraint(struct Corpus *corpus) {
+	static const char operators[] = "+-*/";
+	corpus_appendf(corpus, "constrain on \"%s %s\" size is (", words[corpus_random(corpus, WORDS_COUNT)], words[corpus_random(corpus, WORDS_COUNT)]);
+	size_t terms = 1 + corpus_random(corpus, 6);
+	for (size_t i = 0; i < terms; i++) {
+		if (i > 0)
+			corpus_appendf(corpus, corpus_random(corpus, 2) ? " %c " : "%c", operators[corpus_random(corpus, 4)]);
+
+		if (corpus_random(corpus, 4) == 0)
+			corpus_appendf(corpus, "(%u.%u%c%u)", (unsigned int) corpus_random(corpus, 1000), (unsigned int) corpus_random(corpus, 100), operators[corpus_random(corpus, 4)], (unsigned int) corpus_random(corpus, 100));
+		else
+			corpus_appendf(corpus, "%u", (unsigned int) corpus_random(corpus, 100000));
+	}
+	corpus_append(corpus, ")\n", 2);
+}
+
+// string field "Jello Boxes Vodka Hot ..." with a few hundred words
+static void corpus_long_string(struct Corpus *corpus) {
+	corpus_append(corpus, "string field \"", 14);
+	size_t count = 20 + corpus_random(corpus, 300);
+	for (size_t i = 0; i < count; i++)
+		corpus_appendf(corpus, (i > 0) ? " %s" : "%s", words[corpus_random(corpus, WORDS_COUNT)]);
+	corpus_append(corpus, "\"\n", 2);
+}
+
+// string field "say \"Jello\" to C:\\Boxes\\Vodka"
+static void corpus_escaped_string(struct Corpus *corpus) {
+	corpus_append(corpus, "string field \"", 14);
+	size_t count = 2 + corpus_random(corpus, 12);
+	for (size_t i = 0; i < count; i++) {
+		const char *word = words[corpus_random(corpus, WORDS_COUNT)];
+		switch (corpus_random(corpus, 3)) {
+			case 0:
+				corpus_appendf(corpus, "\\\"%s\\\" ", word);
+				break;
+
+			case 1:
+				corpus_appendf(corpus, "\\\\%s", word);
+				break;
+
+			default:
+				corpus_appendf(corpus, "%s ", word);
+		}
+	}
+	corpus_append(corpus, "\"\n", 2);
+}
+
+// Generates `size` bytes of input shaped like test.txt. The mix picks which
+// kind of line dominates.
+static int corpus_generate(struct Corpus *corpus, size_t size, enum CorpusMix mix, uint64_t seed) {
+	corpus->data = malloc(size);
+	if (corpus->data == NULL) {
+		fprintf(stderr, "Failed to allocate a corpus of %zu bytes.\n", size);
+		return EXIT_FAILURE;
+	}
+
+	corpus->length = 0;
+	corpus->capacity = size;
+	corpus->random = (seed != 0) ? seed : 1;
+	while (corpus->length < corpus->capacity) {
+		uint64_t line = corpus_random(corpus, 10);
+		switch (mix) {
+			case CORPUS_MIX_ARITHMETIC:
+				line = (line < 8) ? 1 : 0;
+				break;
+
+			case CORPUS_MIX_STRINGS:
+				line = (line < 8) ? 2 : 0;
+				break;
+
+			case CORPUS_MIX_ESCAPES:
+				line = (line < 8) ? 3 : 0;
+				break;
+
+			default:
+				line = (line < 4) ? 0 : (line < 8) ? 1 : (line < 9) ? 2 : 3;
+		}
+
+		switch (line) {
+			case 0:
+				corpus_field(corpus);
+				break;
+
+			case 1:
+				corpus_constraint(corpus);
+				break;
+
+			case 2:
+				corpus_long_string(corpus);
+				break;
+
+			default:
+				corpus_escaped_string(corpus);
+		}
+
+		// Blank lines between groups, like test.txt
+		if (corpus_random(corpus, 16) == 0)
+			corpus_append(corpus, "\n", 1);
+	}
+
+	return EXIT_SUCCESS;
+}
+
+static size_t parse_size(const char *text) {
+	char *end = NULL;
+	size_t size = strtoull(text, &end, 10);
+	switch (*end) {
+		case 'G': case 'g':
+			size *= 1024;
+			/* fall through */
+		case 'M': case 'm':
+			size *= 1024;
+			/* fall through */
+		case 'K': case 'k':
+			size *= 1024;
+	}
+
+	return size;
+}
+
+static void print_measurement(const char *name, const struct Measurement *measurement) {
+	double seconds = (measurement->seconds > 0) ? measurement->seconds : 1e-9;
+	printf("%-20s ", name);
+	// tokens_advance() has no input bytes
+	if (measurement->bytes > 0)
+		printf("%12.1f ", (double) measurement->bytes / seconds / (1024 * 1024));
+	else
+		printf("%12s ", "-");
+
+	printf("%14.2f %14zu %12ld\n", (double) measurement->tokens / seconds / 1e6, measurement->allocations, peak_rss_kilobytes() / 1024);
+}
+
+int main(int argc, char **argv) {
+	size_t size = 16 * 1024 * 1024;
+	enum CorpusMix mix = CORPUS_MIX_DEFAULT;
+	uint64_t seed = 1;
+	size_t iterations = 3;
+	const char *path = NULL;
+	for (int i = 1; i < argc; i++) {
+		if (i + 1 >= argc) {
+			print_usage();
+			return 1;
+		}
+
+		if (strcmp(argv[i], "--size") == 0)
+			size = parse_size(argv[++i]);
+		else if (strcmp(argv[i], "--seed") == 0)
+			seed = strtoull(argv[++i], NULL, 10);
+		else if (strcmp(argv[i], "--iterations") == 0)
+			iterations = strtoul(argv[++i], NULL, 10);
+		else if (strcmp(argv[i], "--file") == 0)
+			path = argv[++i];
+		else if (strcmp(argv[i], "--mix") == 0) {
+			i++;
+			if (strcmp(argv[i], "default") == 0)
+				mix = CORPUS_MIX_DEFAULT;
+			else if (strcmp(argv[i], "arithmetic") == 0)
+				mix = CORPUS_MIX_ARITHMETIC;
+			else if (strcmp(argv[i], "strings") == 0)
+				mix = CORPUS_MIX_STRINGS;
+			else if (strcmp(argv[i], "escapes") == 0)
+				mix = CORPUS_MIX_ESCAPES;
+			else {
+				print_usage();
+				return 1;
+			}
+		}
+		else {
+			print_usage();
+			return 1;
+		}
+	}
+
+	if (size == 0 || iterations == 0) {
+		print_usage();
+		return 1;
+	}
+
+	// The corpus is either a real file or generated, and never timed
+	struct Source source = { 0 };
+	struct Corpus corpus = { 0 };
+	char *data = NULL;
+	size_t data_length = 0;
+	if (path != NULL) {
+		if (source_open(path, &source) == EXIT_FAILURE) {
+			fprintf(stderr, "Failed to read \"%s\".\n", path);
+			return 1;
+		}
+		data = source.data;
+		data_length = source.length;
+	}
+	else {
+		if (corpus_generate(&corpus, size, mix, seed) == EXIT_FAILURE)
+			return 1;
+		data = corpus.data;
+		data_length = corpus.length;
+	}
+
+	printf("Input: %zu bytes, best of %zu iterations\n", data_length, iterations);
+	printf("%-20s %12s %14s %14s %12s\n", "benchmark", "MiB/s", "Mtokens/s", "allocations", "peak RSS MiB");
+
+	// tokenize(): the whole scanner, keeping the best run
+	struct Measurement measurement = { 0 };
+	struct Token *tokens = NULL;
+	size_t tokens_length = 0;
+	size_t tokens_capacity = 0;
+	for (size_t i = 0; i < iterations; i++) {
+		if (tokens != NULL)
+			tokens_destroy(tokens, tokens_length);
+
+		size_t allocations_before = allocations;
+		double start = now();
+		tokens = tokenize(data, data_length, &tokens_length, &tokens_capacity);
+		double seconds = now() - start;
+		if (tokens == NULL) {
+			fprintf(stderr, "Failed to tokenize the input.\n");
+			return 1;
+		}
+
+		if (i == 0 || seconds < measurement.seconds) {
+			measurement.seconds = seconds;
+			measurement.allocations = allocations - allocations_before;
+		}
+	}
+	measurement.bytes = data_length;
+	measurement.tokens = tokens_length;
+	print_measurement("tokenize", &measurement);
+
+	// lex(): classification alone. The scanner already typed every token,
+	// so the types are cleared first.
+	measurement.seconds = 0;
+	for (size_t i = 0; i < iterations; i++) {
+		for (size_t j = 0; j < tokens_length; j++) {
+			switch (tokens[j].type) {
+				case TOKEN_TYPE_INTEGER_LITERAL:
+				case TOKEN_TYPE_FLOAT_LITERAL:
+				case TOKEN_TYPE_KEYWORD:
+				case TOKEN_TYPE_IDENTIFIER:
+					tokens[j].type = TOKEN_TYPE_NONE;
+					break;
+
+				default:
+					break;
+			}
+		}
+
+		size_t allocations_before = allocations;
+		double start = now();
+		for (size_t j = 0; j < tokens_length; j++)
+			lex(&(tokens[j]), data);
+		double seconds = now() - start;
+		if (i == 0 || seconds < measurement.seconds) {
+			measurement.seconds = seconds;
+			measurement.allocations = allocations - allocations_before;
+		}
+	}
+	print_measurement("lex", &measurement);
+
+	// token_add_character(): builds an owned copy of every token, one
+	// character at a time
+	size_t bytes = 0;
+	for (size_t j = 0; j < tokens_length; j++)
+		bytes += tokens[j].value_length;
+
+	struct Token *copies = malloc(sizeof(struct Token) * (tokens_length + 1));
+	if (copies == NULL) {
+		fprintf(stderr, "Failed to allocate %zu tokens.\n", tokens_length + 1);
+		return 1;
+	}
+
+	measurement.seconds = 0;
+	for (size_t i = 0; i < iterations; i++) {
+		tokens_init(copies, tokens_length + 1);
+		size_t allocations_before = allocations;
+		double start = now();
+		for (size_t j = 0; j < tokens_length; j++) {
+			const char *text = data + tokens[j].offset;
+			for (unsigned int k = 0; k < tokens[j].value_length; k++)
+				token_add_character(&(copies[j]), text[k]);
+		}
+		double seconds = now() - start;
+		if (i == 0 || seconds < measurement.seconds) {
+			measurement.seconds = seconds;
+			measurement.allocations = allocations - allocations_before;
+		}
+
+		for (size_t j = 0; j < tokens_length; j++)
+			free(copies[j].value);
+	}
+	measurement.bytes = bytes;
+	print_measurement("token_add_character", &measurement);
+	free(copies);
+
+	// tokens_advance(): growing a token buffer to the same number of tokens
+	measurement.seconds = 0;
+	for (size_t i = 0; i < iterations; i++) {
+		size_t length = 0;
+		size_t capacity = 128;
+		struct Token *buffer = malloc(sizeof(struct Token) * capacity);
+		if (buffer == NULL || tokens_init(buffer, capacity) == EXIT_FAILURE) {
+			fprintf(stderr, "Failed to allocate the tokens buffer.\n");
+			return 1;
+		}
+
+		size_t allocations_before = allocations;
+		double start = now();
+		for (size_t j = 0; j < tokens_length; j++) {
+			if (tokens_advance(&buffer, &length, &capacity) == NULL) {
+				fprintf(stderr, "Failed to advance to token %zu.\n", j);
+				return 1;
+			}
+		}
+		double seconds = now() - start;
+		if (i == 0 || seconds < measurement.seconds) {
+			measurement.seconds = seconds;
+			measurement.allocations = allocations - allocations_before;
+		}
+
+		tokens_destroy(buffer, length);
+	}
+	measurement.bytes = 0;
+	print_measurement("tokens_advance", &measurement);
+
+	tokens_destroy(tokens, tokens_length);
+	if (path != NULL)
+		source_close(&source);
+	else
+		free(corpus.data);
+
+	return 0;
+}
@@ -0,0 +1,339 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "cache.h"
+#include "source.h"
+#include "symbols.h"
+#include "tokenizer.h"
+#include "log.h"
+
+static uint64_t cache_align(uint64_t offset) {
+	return (offset + 7) & ~(uint64_t) 7;
+}
+
+uint64_t cache_hash(const char *data, size_t length) {
+	uint64_t hash = 0x9E3779B97F4A7C15ull ^ length;
+	uint64_t word;
+	while (length >= 8) {
+		memcpy(&word, data, 8);
+		hash = (hash ^ word) * 0xFF51AFD7ED558CCDull;
+		hash ^= hash >> 32;
+		data += 8;
+		length -= 8;
+	}
+
+	word = 0;
+	if (length > 0)
+		memcpy(&word, data, length);
+	hash = (hash ^ word) * 0xC4CEB9FE1A85EC53ull;
+	hash ^= hash >> 33;
+	return hash;
+}
+
+// Writes `length` bytes and pads them with zeros up to `end`
+static int cache_write_section(FILE *file, const void *data, size_t length, uint64_t start, uint64_t end) {
+	static const char zeros[8] = { 0 };
+	if (length > 0 && fwrite(data, 1, length, file) != length)
+		return EXIT_FAILURE;
+
+	size_t padding = (size_t) (end - start - length);
+	if (padding > 0 && fwrite(zeros, 1, padding, file) != padding)
+		return EXIT_FAILURE;
+
+	return EXIT_SUCCESS;
+}
+
+int cache_write(const char *path, uint64_t input_hash, size_t input_length, const struct Token *tokens, size_t tokens_length, const struct SymbolTable *symbols) {
+	if (path == NULL) {
+		LOG_ERROR("Provided argument `const char *path` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (tokens == NULL && tokens_length > 0) {
+		LOG_ERROR("Provided argument `const struct Token *tokens` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	size_t symbols_length = symbols_count(symbols);
+	struct CacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+	header.version = CACHE_VERSION;
+	header.header_size = sizeof(struct CacheHeader);
+	header.input_hash = input_hash;
+	header.input_length = input_length;
+	header.tokens_count = tokens_length;
+	header.symbols_count = symbols_length;
+	header.pool_length = 0;
+	for (size_t i = 1; i <= symbols_length; i++) {
+		size_t length = 0;
+		symbols_text(symbols, (uint32_t) i, &length);
+		header.pool_length += length + 1;
+	}
+
+	header.types_offset = cache_align(sizeof(struct CacheHeader));
+	header.flags_offset = cache_align(header.types_offset + tokens_length * sizeof(uint8_t));
+	header.offsets_offset = cache_align(header.flags_offset + tokens_length * sizeof(uint8_t));
+	header.numbers_offset = cache_align(header.offsets_offset + tokens_length * sizeof(uint64_t));
+	header.lengths_offset = cache_align(header.numbers_offset + tokens_length * sizeof(uint64_t));
+	header.symbols_offset = cache_align(header.lengths_offset + tokens_length * sizeof(uint32_t));
+	header.pool_index_offset = cache_align(header.symbols_offset + tokens_length * sizeof(uint32_t));
+	header.pool_offset = cache_align(header.pool_index_offset + symbols_length * sizeof(uint64_t));
+	header.file_length = cache_align(header.pool_offset + header.pool_length);
+
+	// Columns are written in blocks so the whole stream never has to be
+	// copied at once
+	size_t block_length = 4096;
+	uint8_t *types = malloc(block_length * sizeof(uint8_t));
+	uint64_t *offsets = malloc(block_length * sizeof(uint64_t));
+	uint32_t *numbers = malloc(block_length * sizeof(uint32_t));
+	if (types == NULL || offsets == NULL || numbers == NULL) {
+		LOG_ERROR("Failed to allocate the cache write buffers.\n");
+		free(types);
+		free(offsets);
+		free(numbers);
+		return EXIT_FAILURE;
+	}
+
+	char *temporary_path = malloc(strlen(path) + 32);
+	FILE *file = NULL;
+	if (temporary_path != NULL) {
+		sprintf(temporary_path, "%s.%ld.tmp", path, (long) getpid());
+		file = fopen(temporary_path, "wb");
+	}
+
+	if (file == NULL) {
+		LOG_ERROR("Failed to create the cache file for \"%s\": %s.\n", path, strerror(errno));
+		free(temporary_path);
+		free(types);
+		free(offsets);
+		free(numbers);
+		return EXIT_FAILURE;
+	}
+
+	int status = cache_write_section(file, &header, sizeof(header), 0, header.types_offset);
+	for (size_t start = 0; start < tokens_length && status == EXIT_SUCCESS; start += block_length) {
+		size_t count = (tokens_length - start < block_length) ? tokens_length - start : block_length;
+		for (size_t i = 0; i < count; i++)
+			types[i] = (uint8_t) tokens[start + i].type;
+		if (fwrite(types, sizeof(uint8_t), count, file) != count)
+			status = EXIT_FAILURE;
+	}
+	if (status == EXIT_SUCCESS)
+		status = cache_write_section(file, NULL, 0, header.types_offset + tokens_length * sizeof(uint8_t), header.flags_offset);
+
+	for (size_t start = 0; start < tokens_length && status == EXIT_SUCCESS; start += block_length) {
+		size_t count = (tokens_length - start < block_length) ? tokens_length - start : block_length;
+		for (size_t i = 0; i < count; i++)
+			types[i] = (uint8_t) tokens[start + i].metadata.numeric_overflow;
+		if (fwrite(types, sizeof(uint8_t), count, file) != count)
+			status = EXIT_FAILURE;
+	}
+	if (status == EXIT_SUCCESS)
+		status = cache_write_section(file, NULL, 0, header.flags_offset + tokens_length * sizeof(uint8_t), header.offsets_offset);
+
+	for (size_t start = 0; start < tokens_length && status == EXIT_SUCCESS; start += block_length) {
+		size_t count = (tokens_length - start < block_length) ? tokens_length - start : block_length;
+		for (size_t i = 0; i < count; i++)
+			offsets[i] = tokens[start + i].offset;
+		if (fwrite(offsets, sizeof(uint64_t), count, file) != count)
+			status = EXIT_FAILURE;
+	}
+
+	for (size_t start = 0; start < tokens_length && status == EXIT_SUCCESS; start += block_length) {
+		size_t count = (tokens_length - start < block_length) ? tokens_length - start : block_length;
+		for (size_t i = 0; i < count; i++)
+			memcpy(&(offsets[i]), &(tokens[start + i].number), sizeof(uint64_t));
+		if (fwrite(offsets, sizeof(uint64_t), count, file) != count)
+			status = EXIT_FAILURE;
+	}
+
+	for (size_t start = 0; start < tokens_length && status == EXIT_SUCCESS; start += block_length) {
+		size_t count = (tokens_length - start < block_length) ? tokens_length - start : block_length;
+		for (size_t i = 0; i < count; i++)
+			numbers[i] = tokens[start + i].value_length;
+		if (fwrite(numbers, sizeof(uint32_t), count, file) != count)
+			status = EXIT_FAILURE;
+	}
+	if (status == EXIT_SUCCESS)
+		status = cache_write_section(file, NULL, 0, header.lengths_offset + tokens_length * sizeof(uint32_t), header.symbols_offset);
+
+	for (size_t start = 0; start < tokens_length && status == EXIT_SUCCESS; start += block_length) {
+		size_t count = (tokens_length - start < block_length) ? tokens_length - start : block_length;
+		for (size_t i = 0; i < count; i++)
+			numbers[i] = tokens[start + i].symbol;
+		if (fwrite(numbers, sizeof(uint32_t), count, file) != count)
+			status = EXIT_FAILURE;
+	}
+	if (status == EXIT_SUCCESS)
+		status = cache_write_section(file, NULL, 0, header.symbols_offset + tokens_length * sizeof(uint32_t), header.pool_index_offset);
+
+	// Pool index, then the pool itself
+	uint64_t pool_position = 0;
+	for (size_t i = 1; i <= symbols_length && status == EXIT_SUCCESS; i++) {
+		size_t length = 0;
+		symbols_text(symbols, (uint32_t) i, &length);
+		if (fwrite(&pool_position, sizeof(uint64_t), 1, file) != 1)
+			status = EXIT_FAILURE;
+		pool_position += length + 1;
+	}
+
+	for (size_t i = 1; i <= symbols_length && status == EXIT_SUCCESS; i++) {
+		size_t length = 0;
+		const char *text = symbols_text(symbols, (uint32_t) i, &length);
+		if (fwrite(text, 1, length + 1, file) != length + 1)
+			status = EXIT_FAILURE;
+	}
+	if (status == EXIT_SUCCESS)
+		status = cache_write_section(file, NULL, 0, header.pool_offset + header.pool_length, header.file_length);
+
+	if (fclose(file) != 0)
+		status = EXIT_FAILURE;
+
+	if (status == EXIT_SUCCESS && rename(temporary_path, path) != 0)
+		status = EXIT_FAILURE;
+
+	if (status == EXIT_FAILURE) {
+		LOG_ERROR("Failed to write the cache file \"%s\": %s.\n", path, strerror(errno));
+		remove(temporary_path);
+	}
+
+	free(temporary_path);
+	free(types);
+	free(offsets);
+	free(numbers);
+	return status;
+}
+
+// Checks that a section of `count` items of `size` bytes fits in the file
+static bool cache_section_fits(const struct CacheHeader *header, uint64_t offset, uint64_t count, uint64_t size) {
+	return offset % 8 == 0 && offset <= header->file_length && count <= (header->file_length - offset) / size;
+}
+
+int cache_open(const char *path, uint64_t input_hash, size_t input_length, struct TokenCache *cache) {
+	if (path == NULL) {
+		LOG_ERROR("Provided argument `const char *path` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (cache == NULL) {
+		LOG_ERROR("Provided argument `struct TokenCache *cache` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	// A missing file is the usual way to miss, so it is not an error
+	if (access(path, R_OK) != 0) {
+		LOG_INFO("No cache file at \"%s\".\n", path);
+		return EXIT_FAILURE;
+	}
+
+	if (source_open(path, &(cache->file)) == EXIT_FAILURE)
+		return EXIT_FAILURE;
+
+	// Case 1: Not a cache file, or one for some other input (or version)
+	const struct CacheHeader *header = (const struct CacheHeader*) cache->file.data;
+	if (cache->file.length < sizeof(struct CacheHeader)
+		|| memcmp(header->magic, CACHE_MAGIC, sizeof(header->magic)) != 0
+		|| header->version != CACHE_VERSION
+		|| header->header_size != sizeof(struct CacheHeader)
+		|| header->input_hash != input_hash
+		|| header->input_length != input_length) {
+		LOG_INFO("Cache file \"%s\" is stale.\n", path);
+		source_close(&(cache->file));
+		return EXIT_FAILURE;
+	}
+
+	// Case 2: The header does not describe the file (e.g. it was cut short)
+	if (header->file_length != cache->file.length
+		|| ! cache_section_fits(header, header->types_offset, header->tokens_count, sizeof(uint8_t))
+		|| ! cache_section_fits(header, header->flags_offset, header->tokens_count, sizeof(uint8_t))
+		|| ! cache_section_fits(header, header->offsets_offset, header->tokens_count, sizeof(uint64_t))
+		|| ! cache_section_fits(header, header->numbers_offset, header->tokens_count, sizeof(uint64_t))
+		|| ! cache_section_fits(header, header->lengths_offset, header->tokens_count, sizeof(uint32_t))
+		|| ! cache_section_fits(header, header->symbols_offset, header->tokens_count, sizeof(uint32_t))
+		|| ! cache_section_fits(header, header->pool_index_offset, header->symbols_count, sizeof(uint64_t))
+		|| ! cache_section_fits(header, header->pool_offset, header->pool_length, sizeof(char))) {
+		LOG_ERROR("Cache file \"%s\" is corrupt.\n", path);
+		source_close(&(cache->file));
+		return EXIT_FAILURE;
+	}
+
+	const char *base = cache->file.data;
+	cache->header = header;
+	cache->tokens_count = header->tokens_count;
+	cache->types = (const uint8_t*) (base + header->types_offset);
+	cache->flags = (const uint8_t*) (base + header->flags_offset);
+	cache->offsets = (const uint64_t*) (base + header->offsets_offset);
+	cache->numbers = (const uint64_t*) (base + header->numbers_offset);
+	cache->lengths = (const uint32_t*) (base + header->lengths_offset);
+	cache->symbols = (const uint32_t*) (base + header->symbols_offset);
+	cache->symbols_count = header->symbols_count;
+	cache->pool_index = (const uint64_t*) (base + header->pool_index_offset);
+	cache->pool = base + header->pool_offset;
+
+	// Case 3: The pool does not end in a NUL, so its last text would run
+	//         past it. Tokens and pool positions are checked as they are 
+	//         read instead, so opening the file never touches them.
+	if (header->pool_length > 0 && cache->pool[header->pool_length - 1] != '\0') {
+		LOG_ERROR("Cache file \"%s\" is corrupt.\n", path);
+		cache_close(cache);
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+void cache_close(struct TokenCache *cache) {
+	if (cache == NULL) {
+		LOG_ERROR("Provided argument `struct TokenCache *cache` is a NULL pointer.\n");
+		return;
+	}
+
+	source_close(&(cache->file));
+	cache->header = NULL;
+	cache->tokens_count = 0;
+	cache->symbols_count = 0;
+}
+
+int cache_token(const struct TokenCache *cache, size_t index, struct Token *token) {
+	if (cache == NULL || token == NULL) {
+		LOG_ERROR("Provided argument `%s` is a NULL pointer.\n", (cache == NULL) ? "const struct TokenCache *cache" : "struct Token *token");
+		return EXIT_FAILURE;
+	}
+
+	if (index >= cache->tokens_count) {
+		LOG_ERROR("Token %zu is out of range (the cache has %zu).\n", index, cache->tokens_count);
+		return EXIT_FAILURE;
+	}
+
+	// A damaged file can still have the right header
+	uint64_t offset = cache->offsets[index];
+	uint32_t length = cache->lengths[index];
+	uint32_t symbol = cache->symbols[index];
+	if (offset > cache->header->input_length || length > cache->header->input_length - offset || (symbol != SYMBOL_NONE && symbol > cache->symbols_count)) {
+		LOG_ERROR("Token %zu of the cache is corrupt.\n", index);
+		return EXIT_FAILURE;
+	}
+
+	tokens_init(token, 1);
+	token->type = (cache->types[index] < TOKEN_TYPE_COUNT) ? (enum TokenType) cache->types[index] : TOKEN_TYPE_NONE;
+	token->offset = offset;
+	token->value_length = length;
+	token->symbol = symbol;
+	token->metadata.numeric_overflow = cache->flags[index] & 1;
+	memcpy(&(token->number), &(cache->numbers[index]), sizeof(uint64_t));
+	return EXIT_SUCCESS;
+}
+
+const char* cache_symbol_text(const struct TokenCache *cache, uint32_t id) {
+	if (cache == NULL || id == SYMBOL_NONE || id > cache->symbols_count)
+		return NULL;
+
+	uint64_t position = cache->pool_index[id - 1];
+	if (position >= cache->header->pool_length)
+		return NULL;
+
+	return cache->pool + position;
+}
@@ -0,0 +1,88 @@
+#ifndef CACHE_H
+#define CACHE_H
+#include <stddef.h>
+#include <stdint.h>
+#include "source.h"
+#include "symbols.h"
+#include "tokenizer.h"
+#define CACHE_MAGIC "TOKCACHE"
+#define CACHE_VERSION 2
+
+// On-disk layout of a tokenized input. The header is followed by the 
+// sections it points at, each aligned to 8 bytes, so a mapped file is used
+// in place with no parsing:
+//
+//     uint8_t  types[tokens_count]          enum TokenType of each token
+//     uint8_t  flags[tokens_count]          bit 0: numeric_overflow
+//     uint64_t offsets[tokens_count]        span of each token in the input
+//     uint64_t numbers[tokens_count]        value of numeric literals (the
+//                                           bits of the union TokenNumber)
+//     uint32_t lengths[tokens_count]
+//     uint32_t symbols[tokens_count]        symbol id, or SYMBOL_NONE
+//     uint64_t pool_index[symbols_count]    where each symbol's text starts
+//     char     pool[pool_length]            NUL-terminated symbol texts
+//
+// Numbers are in the byte order of the machine that wrote the file; a file
+// written elsewhere fails the magic/version check and is simply a miss.
+struct CacheHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t header_size;
+
+	// The input the tokens came from
+	uint64_t input_hash;
+	uint64_t input_length;
+
+	uint64_t tokens_count;
+	uint64_t symbols_count;
+	uint64_t types_offset;
+	uint64_t flags_offset;
+	uint64_t offsets_offset;
+	uint64_t numbers_offset;
+	uint64_t lengths_offset;
+	uint64_t symbols_offset;
+	uint64_t pool_index_offset;
+	uint64_t pool_offset;
+	uint64_t pool_length;
+	uint64_t file_length;
+};
+
+// A mapped cache file
+struct TokenCache {
+	struct Source file;
+	const struct CacheHeader *header;
+	size_t tokens_count;
+	const uint8_t *types;
+	const uint8_t *flags;
+	const uint64_t *offsets;
+	const uint64_t *numbers;
+	const uint32_t *lengths;
+	const uint32_t *symbols;
+	size_t symbols_count;
+	const uint64_t *pool_index;
+	const char *pool;
+};
+
+// Hash of an input, which (with its length) is what a cache file is keyed by
+uint64_t cache_hash(const char *data, size_t length);
+
+// Writes the tokens of an input to `path`. Symbol ids are those of 
+// `symbols` (which may be NULL if no token has one). The file is written 
+// next to `path` and renamed into place, so readers never see half of it.
+int cache_write(const char *path, uint64_t input_hash, size_t input_length, const struct Token *tokens, size_t tokens_length, const struct SymbolTable *symbols);
+
+// Maps the cache file at `path`. Fails (without logging an error) if there
+// is no such file or it was not written for this exact input. A file whose
+// sections do not fit the header is corrupt and fails as well. Only the 
+// header is read here, so opening takes the same time for any file.
+int cache_open(const char *path, uint64_t input_hash, size_t input_length, struct TokenCache *cache);
+void cache_close(struct TokenCache *cache);
+
+// Fills in `token` (as a span, with its numeric value but no digit or dot
+// counts) from token `index`. Fails if the token is not a span of the 
+// input or its symbol id is out of range, which means the file is corrupt.
+int cache_token(const struct TokenCache *cache, size_t index, struct Token *token);
+
+// Returns the NUL-terminated text of symbol `id`, or NULL
+const char* cache_symbol_text(const struct TokenCache *cache, uint32_t id);
+#endif
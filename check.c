@@ -0,0 +1,431 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include "tokenizer.h"
+#include "source.h"
+#include "spec.h"
+
+// Generated from test.spec by the "check" build target
+#include "check_dialect.h"
+
+// Differential checks. Every other way of tokenizing an input has to give
+// the same tokens as tokenize() of the whole of it, so each check builds
+// random inputs, tokenizes them both ways and compares the results. The
+// first mismatch is printed along with the input, and the run fails.
+//
+// The "check" build target builds and runs this, with a scanner generated
+// from test.spec for the spec checks.
+
+// Pieces the random inputs are made of. They cover every character class
+// (the EOF marker included), escapes in and out of string literals, 
+// numbers that do and do not fit, and the operators and comments of 
+// test.spec.
+static const char *fragments[] = {
+	"field", "constrain", "int", "float", "on", "size", "is", "of",
+	"x", "Jello", "a1", "12", "3.5", "1.2.3", "99999999999999999999", "1e999",
+	" ", "  ", "\t", "\n", "\r\n",
+	"(", ")", "+", "-", "*", "/", "=", "<", ">",
+	"\"", "\"quoted words\"", "\\", "\\\"", "\\\\", "\\n",
+	"==", "<=", "->", "...", "//", "/*", "*/", "// to the end\n", "/* inside */",
+	"\xff"
+};
+
+struct Check {
+	uint64_t random;
+	size_t rounds;
+	size_t failures;
+};
+
+void print_usage() {
+	printf("Usage: check [--rounds N] [--seed N] [--spec FILE] [--corpus FILE]\n");
+}
+
+// xorshift64, so a seed always gives the same inputs
+static uint64_t check_random(struct Check *check, uint64_t bound) {
+	check->random ^= check->random << 13;
+	check->random ^= check->random >> 7;
+	check->random ^= check->random << 17;
+	return (bound == 0) ? 0 : check->random % bound;
+}
+
+// A random input of at most `limit` bytes. The EOF marker is kept rare, so
+// most inputs are read to the end.
+static char* check_input(struct Check *check, size_t limit, size_t *length) {
+	char *data = malloc(limit + 1);
+	if (data == NULL)
+		return NULL;
+
+	size_t count = sizeof(fragments) / sizeof(fragments[0]);
+	(*length) = 0;
+	size_t target = check_random(check, limit + 1);
+	while ((*length) < target) {
+		size_t pick = check_random(check, count);
+		if (pick == count - 1 && check_random(check, 8) != 0)
+			pick = check_random(check, count - 1);
+
+		size_t fragment_length = strlen(fragments[pick]);
+		if ((*length) + fragment_length > limit)
+			break;
+
+		memcpy(data + (*length), fragments[pick], fragment_length);
+		(*length) += fragment_length;
+	}
+	data[(*length)] = '\0';
+	return data;
+}
+
+static void check_fail(struct Check *check, const char *name, const char *data, size_t data_length, const char *format, ...) __attribute__((format(printf, 5, 6)));
+
+static void check_fail(struct Check *check, const char *name, const char *data, size_t data_length, const char *format, ...) {
+	check->failures++;
+	fprintf(stderr, "%s: ", name);
+	va_list arguments;
+	va_start(arguments, format);
+	vfprintf(stderr, format, arguments);
+	va_end(arguments);
+	fprintf(stderr, "\nInput (%zu bytes): \"", data_length);
+	for (size_t i = 0; i < data_length; i++) {
+		unsigned char c = (unsigned char) data[i];
+		if (c == '"' || c == '\\')
+			fprintf(stderr, "\\%c", c);
+		else if (c >= 0x20 && c < 0x7F)
+			fputc(c, stderr);
+		else
+			fprintf(stderr, "\\x%02x", c);
+	}
+	fprintf(stderr, "\"\n");
+}
+
+// Compares one token with the one tokenize() gave. Returns false (after
+// reporting it) if they differ.
+static bool check_token(struct Check *check, const char *name, const char *data, size_t data_length, const struct Token *expected, const struct Token *actual, size_t index) {
+	if (expected->type != actual->type) {
+		check_fail(check, name, data, data_length, "token %zu has type %d instead of %d", index, (int) actual->type, (int) expected->type);
+		return false;
+	}
+
+	if (expected->offset != actual->offset || expected->value_length != actual->value_length) {
+		check_fail(check, name, data, data_length, "token %zu is %u bytes at %zu instead of %u at %zu", index, actual->value_length, actual->offset, expected->value_length, expected->offset);
+		return false;
+	}
+
+	// Tokens that own their value (e.g. ones split between chunks) must
+	// still hold the bytes of the input
+	if (actual->value != NULL && memcmp(actual->value, data + actual->offset, actual->value_length) != 0) {
+		check_fail(check, name, data, data_length, "token %zu has other text than the input", index);
+		return false;
+	}
+
+	return true;
+}
+
+// Compares tokens drained from a stream with the next ones tokenize() gave
+static bool check_drained(struct Check *check, const char *name, const char *data, size_t data_length, const struct Token *expected, size_t expected_length, size_t *checked, const struct Token *drained, size_t drained_length) {
+	for (size_t i = 0; i < drained_length; i++) {
+		if ((*checked) >= expected_length) {
+			check_fail(check, name, data, data_length, "more than the %zu tokens of tokenize()", expected_length);
+			return false;
+		}
+
+		if (! check_token(check, name, data, data_length, &(expected[(*checked)]), &(drained[i]), (*checked)))
+			return false;
+
+		(*checked)++;
+	}
+
+	return true;
+}
+
+// Case 1: The streaming API, with the input cut into chunks at random
+//         points. Each chunk is a copy that is freed right after its
+//         tokens are drained, as it would be when read from a socket.
+static void check_stream(struct Check *check) {
+	for (size_t round = 0; round < check->rounds && check->failures == 0; round++) {
+		size_t data_length = 0;
+		char *data = check_input(check, 200, &data_length);
+		if (data == NULL) {
+			check->failures++;
+			return;
+		}
+
+		size_t expected_length = 0;
+		size_t expected_capacity = 0;
+		struct Token *expected = tokenize(data, data_length, &expected_length, &expected_capacity);
+		struct Tokenizer *tokenizer = tokenizer_create();
+		if (expected == NULL || tokenizer == NULL) {
+			check_fail(check, "stream", data, data_length, "failed to tokenize");
+			if (expected != NULL)
+				tokens_destroy(expected, expected_length);
+			if (tokenizer != NULL)
+				tokenizer_destroy(tokenizer);
+			free(data);
+			return;
+		}
+
+		// Mostly a few large chunks, sometimes single bytes
+		bool bytewise = check_random(check, 4) == 0;
+		size_t checked = 0;
+		size_t drained_length = 0;
+		bool same = true;
+		for (size_t position = 0; position < data_length && same; ) {
+			size_t chunk_length = bytewise ? 1 : 1 + check_random(check, data_length - position);
+			char *chunk = malloc(chunk_length);
+			if (chunk == NULL) {
+				check->failures++;
+				same = false;
+				break;
+			}
+			memcpy(chunk, data + position, chunk_length);
+			position += chunk_length;
+
+			struct Token *drained = NULL;
+			if (tokenizer_feed(tokenizer, chunk, chunk_length) == EXIT_FAILURE || (drained = tokenizer_drain(tokenizer, &drained_length)) == NULL) {
+				check_fail(check, "stream", data, data_length, "feeding %zu bytes at %zu failed", chunk_length, position - chunk_length);
+				same = false;
+			}
+			else
+				same = check_drained(check, "stream", data, data_length, expected, expected_length, &checked, drained, drained_length);
+			free(chunk);
+		}
+
+		if (same) {
+			struct Token *drained = NULL;
+			if (tokenizer_finish(tokenizer) == EXIT_FAILURE || (drained = tokenizer_drain(tokenizer, &drained_length)) == NULL)
+				check_fail(check, "stream", data, data_length, "finishing failed");
+			else if (check_drained(check, "stream", data, data_length, expected, expected_length, &checked, drained, drained_length) && checked != expected_length)
+				check_fail(check, "stream", data, data_length, "%zu tokens instead of %zu", checked, expected_length);
+		}
+
+		tokenizer_destroy(tokenizer);
+		tokens_destroy(expected, expected_length);
+		free(data);
+	}
+}
+
+// Where an edit starts: often at either end of the input or just inside a
+// string literal or escape, where a restart point is hardest to pick
+static size_t check_edit_start(struct Check *check, const char *data, size_t data_length) {
+	switch (check_random(check, 4)) {
+		case 0:
+			return 0;
+		case 1:
+			return data_length;
+		case 2:
+			for (size_t tries = 0; tries < 8 && data_length > 0; tries++) {
+				size_t position = check_random(check, data_length);
+				if (data[position] == '"' || data[position] == '\\')
+					return position + 1;
+			}
+			break;
+	}
+
+	return check_random(check, data_length + 1);
+}
+
+// Case 2: Incremental retokenizing. A random edit (which may remove or
+//         insert nothing) is applied through tokenize_edit(), and the 
+//         result has to be what tokenize() gives for the edited input.
+static void check_edit(struct Check *check) {
+	for (size_t round = 0; round < check->rounds && check->failures == 0; round++) {
+		size_t old_length = 0;
+		size_t inserted_length = 0;
+		char *old_data = check_input(check, 200, &old_length);
+		char *inserted = check_input(check, (check_random(check, 4) == 0) ? 0 : 40, &inserted_length);
+		char *data = malloc(old_length + inserted_length + 1);
+		if (old_data == NULL || inserted == NULL || data == NULL) {
+			check->failures++;
+			free(old_data);
+			free(inserted);
+			free(data);
+			return;
+		}
+
+		size_t edit_start = check_edit_start(check, old_data, old_length);
+		size_t removed_length = check_random(check, (old_length - edit_start) + 1);
+		// Small removals (or none) half of the time
+		if (check_random(check, 2) == 0) {
+			size_t small = check_random(check, 3);
+			if (small < removed_length)
+				removed_length = small;
+		}
+
+		memcpy(data, old_data, edit_start);
+		memcpy(data + edit_start, inserted, inserted_length);
+		memcpy(data + edit_start + inserted_length, old_data + edit_start + removed_length, old_length - edit_start - removed_length);
+		size_t data_length = old_length - removed_length + inserted_length;
+		data[data_length] = '\0';
+
+		size_t tokens_length = 0;
+		size_t tokens_capacity = 0;
+		size_t expected_length = 0;
+		size_t expected_capacity = 0;
+		struct Token *tokens = tokenize(old_data, old_length, &tokens_length, &tokens_capacity);
+		struct Token *expected = tokenize(data, data_length, &expected_length, &expected_capacity);
+		if (tokens == NULL || expected == NULL)
+			check_fail(check, "edit", data, data_length, "failed to tokenize");
+		else if (tokenize_edit(&tokens, &tokens_length, &tokens_capacity, data, data_length, edit_start, removed_length, inserted_length) == EXIT_FAILURE)
+			check_fail(check, "edit", data, data_length, "replacing %zu bytes at %zu with %zu failed", removed_length, edit_start, inserted_length);
+		else if (tokens_length != expected_length)
+			check_fail(check, "edit", data, data_length, "replacing %zu bytes at %zu with %zu gave %zu tokens instead of %zu", removed_length, edit_start, inserted_length, tokens_length, expected_length);
+		else {
+			for (size_t i = 0; i < tokens_length; i++) {
+				if (! check_token(check, "edit", data, data_length, &(expected[i]), &(tokens[i]), i)) {
+					fprintf(stderr, "The edit replaced %zu bytes at %zu with %zu.\n", removed_length, edit_start, inserted_length);
+					break;
+				}
+			}
+		}
+
+		if (tokens != NULL)
+			tokens_destroy(tokens, tokens_length);
+		if (expected != NULL)
+			tokens_destroy(expected, expected_length);
+		free(old_data);
+		free(inserted);
+		free(data);
+	}
+}
+
+// Compares the tokens of one input with those tokenize_with_spec() gave,
+// rule indices of operators included
+static void check_spec_tokens(struct Check *check, const char *name, const char *data, size_t data_length, const struct Token *expected, size_t expected_length, const struct Token *tokens, size_t tokens_length) {
+	if (tokens_length != expected_length) {
+		check_fail(check, name, data, data_length, "%zu tokens instead of %zu", tokens_length, expected_length);
+		return;
+	}
+
+	for (size_t i = 0; i < tokens_length; i++) {
+		if (! check_token(check, name, data, data_length, &(expected[i]), &(tokens[i]), i))
+			return;
+
+		if (expected[i].symbol != tokens[i].symbol) {
+			check_fail(check, name, data, data_length, "token %zu has rule %u instead of %u", i, tokens[i].symbol, expected[i].symbol);
+			return;
+		}
+	}
+}
+
+// Tokenizes one input by `spec` with the generated scanner and the pull 
+// API, and compares both with tokenize_with_spec()
+static void check_spec_input(struct Check *check, const struct TokenSpec *spec, char *data, size_t data_length) {
+	size_t expected_length = 0;
+	size_t expected_capacity = 0;
+	struct Token *expected = tokenize_with_spec(spec, NULL, data, data_length, &expected_length, &expected_capacity);
+	if (expected == NULL) {
+		check_fail(check, "spec", data, data_length, "tokenize_with_spec() failed");
+		return;
+	}
+
+	size_t generated_length = 0;
+	size_t generated_capacity = 0;
+	struct Token *generated = check_dialect_tokenize(data, data_length, &generated_length, &generated_capacity);
+	if (generated == NULL)
+		check_fail(check, "generated", data, data_length, "the generated scanner failed");
+	else {
+		check_spec_tokens(check, "generated", data, data_length, expected, expected_length, generated, generated_length);
+		tokens_destroy(generated, generated_length);
+	}
+
+	// The pull API hands out tokens one at a time, so collect them first
+	struct Token *pulled = malloc(sizeof(struct Token) * (expected_length + 1));
+	struct Tokenizer *tokenizer = tokenizer_open_with_spec(spec, data, data_length);
+	if (pulled == NULL || tokenizer == NULL)
+		check_fail(check, "pull", data, data_length, "failed to open a tokenizer");
+	else {
+		size_t pulled_length = 0;
+		enum TokenizerNext next = TOKENIZER_NEXT_END;
+		while (pulled_length <= expected_length && (next = tokenizer_next(tokenizer, &(pulled[pulled_length]))) == TOKENIZER_NEXT_TOKEN)
+			pulled_length++;
+
+		if (next == TOKENIZER_NEXT_ERROR)
+			check_fail(check, "pull", data, data_length, "tokenizer_next() failed after %zu tokens", pulled_length);
+		else
+			check_spec_tokens(check, "pull", data, data_length, expected, expected_length, pulled, pulled_length);
+	}
+
+	if (tokenizer != NULL)
+		tokenizer_destroy(tokenizer);
+	free(pulled);
+	tokens_destroy(expected, expected_length);
+}
+
+// Case 3: A token spec. The scanner generated from it, and the pull API
+//         with it loaded, have to give the tokens tokenize_with_spec() 
+//         does, both for random inputs and for the corpus file.
+static void check_spec(struct Check *check, const char *spec_path, const char *corpus_path) {
+	struct TokenSpec *spec = spec_load(spec_path);
+	if (spec == NULL) {
+		fprintf(stderr, "Failed to load the spec \"%s\".\n", spec_path);
+		check->failures++;
+		return;
+	}
+
+	struct Source corpus;
+	if (source_open(corpus_path, &corpus) == EXIT_FAILURE) {
+		fprintf(stderr, "Failed to load the corpus \"%s\".\n", corpus_path);
+		check->failures++;
+	}
+	else {
+		check_spec_input(check, spec, corpus.data, corpus.length);
+		source_close(&corpus);
+	}
+
+	for (size_t round = 0; round < check->rounds && check->failures == 0; round++) {
+		size_t data_length = 0;
+		char *data = check_input(check, 200, &data_length);
+		if (data == NULL) {
+			check->failures++;
+			break;
+		}
+
+		check_spec_input(check, spec, data, data_length);
+		free(data);
+	}
+
+	spec_destroy(spec);
+}
+
+int main(int argc, char **argv) {
+	struct Check check;
+	check.random = 0x2545F4914F6CDD1Dull;
+	check.rounds = 20000;
+	check.failures = 0;
+	const char *spec_path = "test.spec";
+	const char *corpus_path = "test.txt";
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc)
+			check.rounds = strtoul(argv[++i], NULL, 10);
+		else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+			check.random = strtoull(argv[++i], NULL, 10);
+			if (check.random == 0)
+				check.random = 1;
+		}
+		else if (strcmp(argv[i], "--spec") == 0 && i + 1 < argc)
+			spec_path = argv[++i];
+		else if (strcmp(argv[i], "--corpus") == 0 && i + 1 < argc)
+			corpus_path = argv[++i];
+		else {
+			print_usage();
+			return 1;
+		}
+	}
+
+	bool passed = true;
+	check_stream(&check);
+	printf("stream: %s\n", (check.failures == 0) ? "ok" : "FAILED");
+	passed = passed && check.failures == 0;
+
+	check.failures = 0;
+	check_edit(&check);
+	printf("edit: %s\n", (check.failures == 0) ? "ok" : "FAILED");
+	passed = passed && check.failures == 0;
+
+	check.failures = 0;
+	check_spec(&check, spec_path, corpus_path);
+	printf("spec: %s\n", (check.failures == 0) ? "ok" : "FAILED");
+	passed = passed && check.failures == 0;
+	return passed ? 0 : 1;
+}
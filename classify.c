@@ -0,0 +1,338 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "classify.h"
+#include "log.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CLASSIFY_X86 1
+#endif
+
+typedef size_t (*ClassifyRunFunction)(const struct CharClasses *classes, const char *data, size_t length, bool in_quote, struct RunCounts *counts);
+typedef size_t (*ClassifyWhitespaceFunction)(const char *data, size_t length);
+typedef size_t (*ClassifyLineStartsFunction)(const char *data, size_t length, size_t base, size_t *starts);
+
+static ClassifyRunFunction run_function = NULL;
+static ClassifyWhitespaceFunction whitespace_function = NULL;
+static ClassifyLineStartsFunction line_starts_function = NULL;
+static enum ClassifyImplementation implementation = CLASSIFY_IMPLEMENTATION_SCALAR;
+static pthread_once_t select_once = PTHREAD_ONCE_INIT;
+
+static inline bool classify_is_whitespace(unsigned char c) {
+	return c == ' ' || c == '\t' || c == '\n';
+}
+
+// Scalar versions. These also finish off the last few bytes for the SIMD
+// versions, which only look at whole vectors.
+static size_t scalar_run(const struct CharClasses *classes, const char *data, size_t length, bool in_quote, struct RunCounts *counts) {
+	const unsigned char *stops = in_quote ? classes->stops_inside : classes->stops_outside;
+	size_t index = 0;
+	unsigned char c;
+	while (index < length) {
+		c = (unsigned char) data[index];
+		if (stops[c])
+			break;
+
+		counts->digits += (unsigned int) (c - '0') < 10;
+		counts->dots += c == '.';
+		index++;
+	}
+
+	return index;
+}
+
+static size_t scalar_whitespace_run(const char *data, size_t length) {
+	size_t index = 0;
+	while (index < length && classify_is_whitespace((unsigned char) data[index]))
+		index++;
+
+	return index;
+}
+
+static size_t scalar_line_starts(const char *data, size_t length, size_t base, size_t *starts) {
+	size_t count = 0;
+	for (size_t i = 0; i < length; i++) {
+		if (data[i] == '\n')
+			starts[count++] = base + i + 1;
+	}
+
+	return count;
+}
+
+#ifdef CLASSIFY_X86
+// SSE2 is part of x86-64 itself, so this needs no CPU check there
+static size_t sse2_run(const struct CharClasses *classes, const char *data, size_t length, bool in_quote, struct RunCounts *counts) {
+	const unsigned char (*vectors)[32] = in_quote ? classes->inside_vectors : classes->outside_vectors;
+	size_t count = in_quote ? classes->inside_count : classes->outside_count;
+	const __m128i zero = _mm_set1_epi8('0');
+	const __m128i nine = _mm_set1_epi8(9);
+	const __m128i dot = _mm_set1_epi8('.');
+	size_t index = 0;
+	while (index + 16 <= length) {
+		__m128i block = _mm_loadu_si128((const __m128i*) (data + index));
+		__m128i stop = _mm_setzero_si128();
+		for (size_t i = 0; i < count; i++)
+			stop = _mm_or_si128(stop, _mm_cmpeq_epi8(block, _mm_loadu_si128((const __m128i*) vectors[i])));
+
+		// A byte is a digit if (byte - '0') is at most 9 as an unsigned value
+		__m128i shifted = _mm_sub_epi8(block, zero);
+		unsigned int digit_mask = (unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(shifted, nine), shifted));
+		unsigned int dot_mask = (unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(block, dot));
+		unsigned int stop_mask = (unsigned int) _mm_movemask_epi8(stop);
+		if (stop_mask != 0) {
+			unsigned int run = (unsigned int) __builtin_ctz(stop_mask);
+			unsigned int keep = (1u << run) - 1;
+			counts->digits += (unsigned int) __builtin_popcount(digit_mask & keep);
+			counts->dots += (unsigned int) __builtin_popcount(dot_mask & keep);
+			return index + run;
+		}
+
+		counts->digits += (unsigned int) __builtin_popcount(digit_mask);
+		counts->dots += (unsigned int) __builtin_popcount(dot_mask);
+		index += 16;
+	}
+
+	return index + scalar_run(classes, data + index, length - index, in_quote, counts);
+}
+
+static size_t sse2_whitespace_run(const char *data, size_t length) {
+	const __m128i space = _mm_set1_epi8(' ');
+	const __m128i tab = _mm_set1_epi8('\t');
+	const __m128i newline = _mm_set1_epi8('\n');
+	size_t index = 0;
+	while (index + 16 <= length) {
+		__m128i block = _mm_loadu_si128((const __m128i*) (data + index));
+		__m128i whitespace = _mm_or_si128(_mm_cmpeq_epi8(block, space), _mm_or_si128(_mm_cmpeq_epi8(block, tab), _mm_cmpeq_epi8(block, newline)));
+		unsigned int other_mask = ~((unsigned int) _mm_movemask_epi8(whitespace)) & 0xFFFFu;
+		if (other_mask != 0)
+			return index + (unsigned int) __builtin_ctz(other_mask);
+
+		index += 16;
+	}
+
+	return index + scalar_whitespace_run(data + index, length - index);
+}
+
+static size_t sse2_line_starts(const char *data, size_t length, size_t base, size_t *starts) {
+	const __m128i newline = _mm_set1_epi8('\n');
+	size_t count = 0;
+	size_t index = 0;
+	for (; index + 16 <= length; index += 16) {
+		__m128i block = _mm_loadu_si128((const __m128i*) (data + index));
+		unsigned int mask = (unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(block, newline));
+		while (mask != 0) {
+			starts[count++] = base + index + (unsigned int) __builtin_ctz(mask) + 1;
+			mask &= mask - 1;
+		}
+	}
+
+	return count + scalar_line_starts(data + index, length - index, base + index, starts + count);
+}
+
+__attribute__((target("avx2,popcnt")))
+static size_t avx2_run(const struct CharClasses *classes, const char *data, size_t length, bool in_quote, struct RunCounts *counts) {
+	const unsigned char (*vectors)[32] = in_quote ? classes->inside_vectors : classes->outside_vectors;
+	size_t count = in_quote ? classes->inside_count : classes->outside_count;
+	const __m256i zero = _mm256_set1_epi8('0');
+	const __m256i nine = _mm256_set1_epi8(9);
+	const __m256i dot = _mm256_set1_epi8('.');
+	size_t index = 0;
+	while (index + 32 <= length) {
+		__m256i block = _mm256_loadu_si256((const __m256i*) (data + index));
+		__m256i stop = _mm256_setzero_si256();
+		for (size_t i = 0; i < count; i++)
+			stop = _mm256_or_si256(stop, _mm256_cmpeq_epi8(block, _mm256_loadu_si256((const __m256i*) vectors[i])));
+
+		__m256i shifted = _mm256_sub_epi8(block, zero);
+		unsigned int digit_mask = (unsigned int) _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_min_epu8(shifted, nine), shifted));
+		unsigned int dot_mask = (unsigned int) _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, dot));
+		unsigned int stop_mask = (unsigned int) _mm256_movemask_epi8(stop);
+		if (stop_mask != 0) {
+			unsigned int run = (unsigned int) __builtin_ctz(stop_mask);
+			unsigned int keep = (1u << run) - 1;
+			counts->digits += (unsigned int) __builtin_popcount(digit_mask & keep);
+			counts->dots += (unsigned int) __builtin_popcount(dot_mask & keep);
+			return index + run;
+		}
+
+		counts->digits += (unsigned int) __builtin_popcount(digit_mask);
+		counts->dots += (unsigned int) __builtin_popcount(dot_mask);
+		index += 32;
+	}
+
+	return index + sse2_run(classes, data + index, length - index, in_quote, counts);
+}
+
+__attribute__((target("avx2")))
+static size_t avx2_whitespace_run(const char *data, size_t length) {
+	const __m256i space = _mm256_set1_epi8(' ');
+	const __m256i tab = _mm256_set1_epi8('\t');
+	const __m256i newline = _mm256_set1_epi8('\n');
+	size_t index = 0;
+	while (index + 32 <= length) {
+		__m256i block = _mm256_loadu_si256((const __m256i*) (data + index));
+		__m256i whitespace = _mm256_or_si256(_mm256_cmpeq_epi8(block, space), _mm256_or_si256(_mm256_cmpeq_epi8(block, tab), _mm256_cmpeq_epi8(block, newline)));
+		unsigned int other_mask = ~((unsigned int) _mm256_movemask_epi8(whitespace));
+		if (other_mask != 0)
+			return index + (unsigned int) __builtin_ctz(other_mask);
+
+		index += 32;
+	}
+
+	return index + sse2_whitespace_run(data + index, length - index);
+}
+
+__attribute__((target("avx2")))
+static size_t avx2_line_starts(const char *data, size_t length, size_t base, size_t *starts) {
+	const __m256i newline = _mm256_set1_epi8('\n');
+	size_t count = 0;
+	size_t index = 0;
+	for (; index + 32 <= length; index += 32) {
+		__m256i block = _mm256_loadu_si256((const __m256i*) (data + index));
+		unsigned int mask = (unsigned int) _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, newline));
+		while (mask != 0) {
+			starts[count++] = base + index + (unsigned int) __builtin_ctz(mask) + 1;
+			mask &= mask - 1;
+		}
+	}
+
+	return count + sse2_line_starts(data + index, length - index, base + index, starts + count);
+}
+#endif
+
+int classify_set_implementation(enum ClassifyImplementation requested) {
+	switch (requested) {
+		case CLASSIFY_IMPLEMENTATION_AUTO:
+#ifdef CLASSIFY_X86
+			__builtin_cpu_init();
+			if (__builtin_cpu_supports("avx2"))
+				return classify_set_implementation(CLASSIFY_IMPLEMENTATION_AVX2);
+			return classify_set_implementation(CLASSIFY_IMPLEMENTATION_SSE2);
+#else
+			return classify_set_implementation(CLASSIFY_IMPLEMENTATION_SCALAR);
+#endif
+
+		case CLASSIFY_IMPLEMENTATION_SCALAR:
+			run_function = scalar_run;
+			whitespace_function = scalar_whitespace_run;
+			line_starts_function = scalar_line_starts;
+			break;
+
+#ifdef CLASSIFY_X86
+		case CLASSIFY_IMPLEMENTATION_SSE2:
+			__builtin_cpu_init();
+			if (! __builtin_cpu_supports("sse2")) {
+				LOG_ERROR("This CPU does not support SSE2.\n");
+				return EXIT_FAILURE;
+			}
+			run_function = sse2_run;
+			whitespace_function = sse2_whitespace_run;
+			line_starts_function = sse2_line_starts;
+			break;
+
+		case CLASSIFY_IMPLEMENTATION_AVX2:
+			__builtin_cpu_init();
+			if (! __builtin_cpu_supports("avx2")) {
+				LOG_ERROR("This CPU does not support AVX2.\n");
+				return EXIT_FAILURE;
+			}
+			run_function = avx2_run;
+			whitespace_function = avx2_whitespace_run;
+			line_starts_function = avx2_line_starts;
+			break;
+#endif
+
+		default:
+			LOG_ERROR("Implementation \"%s\" is not available on this platform.\n", classify_implementation_name(requested));
+			return EXIT_FAILURE;
+	}
+
+	implementation = requested;
+	return EXIT_SUCCESS;
+}
+
+enum ClassifyImplementation classify_get_implementation(void) {
+	return implementation;
+}
+
+const char* classify_implementation_name(enum ClassifyImplementation requested) {
+	switch (requested) {
+		case CLASSIFY_IMPLEMENTATION_AUTO:
+			return "auto";
+		case CLASSIFY_IMPLEMENTATION_SCALAR:
+			return "scalar";
+		case CLASSIFY_IMPLEMENTATION_SSE2:
+			return "sse2";
+		case CLASSIFY_IMPLEMENTATION_AVX2:
+			return "avx2";
+		default:
+			return "unknown";
+	}
+}
+
+static void classify_select(void) {
+	// Only pick one if nobody asked for a specific implementation yet
+	if (run_function == NULL)
+		classify_set_implementation(CLASSIFY_IMPLEMENTATION_AUTO);
+}
+
+// Adds a stop byte to a list and broadcasts it for the SIMD scanners
+static void classify_add_stop(unsigned char *table, unsigned char *bytes, unsigned char (*vectors)[32], size_t *count, unsigned char c) {
+	if (table[c])
+		return;
+
+	table[c] = 1;
+	if ((*count) >= CLASSIFY_MAX_STOPS) {
+		LOG_DEBUG("More than %d stop characters. Falling back to the scalar scanner.\n", CLASSIFY_MAX_STOPS);
+		(*count)++;
+		return;
+	}
+
+	bytes[(*count)] = c;
+	memset(vectors[(*count)], c, 32);
+	(*count)++;
+}
+
+void classify_init(struct CharClasses *classes, const unsigned char *special_char_lookup_table) {
+	pthread_once(&select_once, classify_select);
+
+	memset(classes->stops_outside, 0, sizeof(classes->stops_outside));
+	memset(classes->stops_inside, 0, sizeof(classes->stops_inside));
+	classes->outside_count = 0;
+	classes->inside_count = 0;
+
+	// Inside a string literal only these have a meaning of their own
+	const unsigned char inside[] = { '"', '\\', (unsigned char) EOF };
+	for (size_t i = 0; i < sizeof(inside); i++) {
+		classify_add_stop(classes->stops_inside, classes->inside_bytes, classes->inside_vectors, &(classes->inside_count), inside[i]);
+		classify_add_stop(classes->stops_outside, classes->outside_bytes, classes->outside_vectors, &(classes->outside_count), inside[i]);
+	}
+
+	const unsigned char whitespace[] = { ' ', '\t', '\n' };
+	for (size_t i = 0; i < sizeof(whitespace); i++)
+		classify_add_stop(classes->stops_outside, classes->outside_bytes, classes->outside_vectors, &(classes->outside_count), whitespace[i]);
+
+	for (int c = 0; c < 256; c++) {
+		if (special_char_lookup_table[c])
+			classify_add_stop(classes->stops_outside, classes->outside_bytes, classes->outside_vectors, &(classes->outside_count), (unsigned char) c);
+	}
+}
+
+size_t classify_run(const struct CharClasses *classes, const char *data, size_t length, bool in_quote, struct RunCounts *counts) {
+	// The vectors only hold CLASSIFY_MAX_STOPS stop bytes
+	if (classes->outside_count > CLASSIFY_MAX_STOPS)
+		return scalar_run(classes, data, length, in_quote, counts);
+
+	return run_function(classes, data, length, in_quote, counts);
+}
+
+size_t classify_whitespace_run(const char *data, size_t length) {
+	pthread_once(&select_once, classify_select);
+	return whitespace_function(data, length);
+}
+
+size_t classify_line_starts(const char *data, size_t length, size_t base, size_t *starts) {
+	pthread_once(&select_once, classify_select);
+	return line_starts_function(data, length, base, starts);
+}
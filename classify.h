@@ -0,0 +1,61 @@
+#ifndef CLASSIFY_H
+#define CLASSIFY_H
+#include <stddef.h>
+#include <stdbool.h>
+#define CLASSIFY_MAX_STOPS 32
+
+enum ClassifyImplementation {
+	CLASSIFY_IMPLEMENTATION_AUTO,
+	CLASSIFY_IMPLEMENTATION_SCALAR,
+	CLASSIFY_IMPLEMENTATION_SSE2,
+	CLASSIFY_IMPLEMENTATION_AVX2
+};
+
+// Which bytes end a run of ordinary characters. Outside a string literal 
+// that is whitespace, quotes, backslashes, EOF markers and the special
+// characters; inside one only quotes, backslashes and EOF markers do.
+// Each stop byte is also kept broadcast across a vector so the SIMD 
+// scanners can load it instead of rebuilding it on every call. With more
+// than CLASSIFY_MAX_STOPS stop bytes, only the scalar scanner is used.
+struct CharClasses {
+	unsigned char stops_outside[256];
+	unsigned char stops_inside[256];
+
+	size_t outside_count;
+	unsigned char outside_bytes[CLASSIFY_MAX_STOPS];
+	unsigned char outside_vectors[CLASSIFY_MAX_STOPS][32];
+	size_t inside_count;
+	unsigned char inside_bytes[CLASSIFY_MAX_STOPS];
+	unsigned char inside_vectors[CLASSIFY_MAX_STOPS][32];
+};
+
+// Counts gathered over a run, for struct TokenMetadata
+struct RunCounts {
+	unsigned int digits;
+	unsigned int dots;
+};
+
+// Builds the classes for a set of special characters (a 256 entry table,
+// non-zero for special characters)
+void classify_init(struct CharClasses *classes, const unsigned char *special_char_lookup_table);
+
+// Returns how many bytes from the start of `data` are ordinary characters,
+// adding the digits and dots among them to `counts`. 16 or 32 bytes are 
+// classified at a time when the CPU supports it.
+size_t classify_run(const struct CharClasses *classes, const char *data, size_t length, bool in_quote, struct RunCounts *counts);
+
+// Returns how many bytes from the start of `data` are whitespace
+size_t classify_whitespace_run(const char *data, size_t length);
+
+// Writes `base` plus the offset just past each newline in `data` (where the
+// next line starts) to `starts`, which needs room for up to `length` 
+// entries, and returns how many there were
+size_t classify_line_starts(const char *data, size_t length, size_t base, size_t *starts);
+
+// Picks the implementation used by every tokenizer in the process. AUTO 
+// (the default) uses the widest one the CPU supports. Returns EXIT_FAILURE
+// if the requested one is not available.
+int classify_set_implementation(enum ClassifyImplementation implementation);
+enum ClassifyImplementation classify_get_implementation(void);
+const char* classify_implementation_name(enum ClassifyImplementation implementation);
+#endif
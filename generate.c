@@ -0,0 +1,667 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "spec.h"
+#include "log.h"
+
+// Writes a scanner specialized for one token spec: `generate SPEC NAME`
+// creates NAME.h and NAME.c, which define NAME_tokenize(). It returns the
+// same tokens tokenize_with_spec() does with SPEC loaded, but everything
+// the spec decides is a constant in the code: the class of every byte, the
+// stop bytes of the SIMD run loops, the operator trie (unrolled into
+// nested compares) and the keywords (compared by length, then memcmp()
+// against literals). The scanner's states are labels, and each picks the
+// next action from a jump table of label addresses (a GCC extension), so
+// there is no switch in the loop.
+
+// Classes as in tokenizer.c
+static const char *class_names[] = {
+	"ORDINARY",
+	"WHITESPACE",
+	"BACKSLASH",
+	"QUOTE",
+	"SPECIAL",
+	"EOF"
+};
+
+enum {
+	CLASS_ORDINARY,
+	CLASS_WHITESPACE,
+	CLASS_BACKSLASH,
+	CLASS_QUOTE,
+	CLASS_SPECIAL,
+	CLASS_EOF
+};
+
+// Writes a template line by line, with every '@' replaced by the name
+static void emit(FILE *out, const char *name, const char *text) {
+	for (const char *c = text; (*c) != '\0'; c++) {
+		if ((*c) == '@')
+			fputs(name, out);
+		else
+			fputc((*c), out);
+	}
+}
+
+// A byte as a C constant. `as_char` is for places that need a char (which
+// may be signed) rather than the value of an unsigned char.
+static void emit_byte(FILE *out, unsigned char c, bool as_char) {
+	if (c == '\'' || c == '\\')
+		fprintf(out, "'\\%c'", c);
+	else if (c == '\t')
+		fputs("'\\t'", out);
+	else if (c == '\n')
+		fputs("'\\n'", out);
+	else if (c >= 0x20 && c < 0x7F)
+		fprintf(out, "'%c'", c);
+	else
+		fprintf(out, as_char ? "(char) 0x%02X" : "0x%02X", c);
+}
+
+// Octal escapes, unlike hex ones, can't run into the next character
+static void emit_string(FILE *out, const char *text, size_t length) {
+	fputc('"', out);
+	for (size_t i = 0; i < length; i++) {
+		unsigned char c = (unsigned char) text[i];
+		if (c == '"' || c == '\\')
+			fprintf(out, "\\%c", c);
+		else if (c >= 0x20 && c < 0x7F)
+			fputc(c, out);
+		else
+			fprintf(out, "\\%03o", c);
+	}
+	fputc('"', out);
+}
+
+static void emit_indent(FILE *out, size_t depth) {
+	for (size_t i = 0; i < depth; i++)
+		fputc('\t', out);
+}
+
+// One level of the operator trie: a compare per child of `node`, each
+// remembering the match if the child ends an entry
+static void emit_trie(FILE *out, const struct TokenSpec *spec, size_t node, size_t depth) {
+	bool first = true;
+	for (int c = 0; c < 256; c++) {
+		unsigned char column = spec->byte_columns[c];
+		if (column == 0)
+			continue;
+
+		size_t child = spec->next[(node * spec->columns) + column];
+		if (child == 0)
+			continue;
+
+		emit_indent(out, depth + 1);
+		fprintf(out, "%sif (length > %zu && text[%zu] == ", first ? "" : "else ", depth, depth);
+		emit_byte(out, (unsigned char) c, false);
+		fputs(") {\n", out);
+		if (spec->accepts[child] != 0) {
+			emit_indent(out, depth + 2);
+			fprintf(out, "matched = %zu;\n", depth + 1);
+			emit_indent(out, depth + 2);
+			fprintf(out, "(*rule) = %u;\n", spec->accepts[child] - 1);
+		}
+
+		emit_trie(out, spec, child, depth + 1);
+		emit_indent(out, depth + 1);
+		fputs("}\n", out);
+		first = false;
+	}
+}
+
+static void emit_classes(FILE *out, const char *name, const unsigned char *classes) {
+	emit(out, name, "static const unsigned char @_classes[256] = {\n");
+	for (int c = 0; c < 256; c++) {
+		if (classes[c] == CLASS_ORDINARY)
+			continue;
+
+		fputs("\t[", out);
+		if (c == 0xFF)
+			fputs("0xFF", out);
+		else
+			emit_byte(out, (unsigned char) c, false);
+		fprintf(out, "] = %s_CLASS_%s,\n", name, class_names[classes[c]]);
+	}
+	fputs("};\n\n", out);
+}
+
+static void emit_keywords(FILE *out, const char *name, const struct TokenSpec *spec) {
+	emit(out, name, "static inline bool @_keyword(const char *text, unsigned int length) {\n");
+	size_t longest = 0;
+	for (size_t i = 0; i < spec->keywords_length; i++) {
+		size_t length = strlen(spec->keywords[i]);
+		if (length > longest)
+			longest = length;
+	}
+
+	for (size_t length = 1; length <= longest; length++) {
+		bool any = false;
+		for (size_t i = 0; i < spec->keywords_length; i++) {
+			if (strlen(spec->keywords[i]) != length)
+				continue;
+
+			if (! any)
+				fprintf(out, "\tif (length == %zu)\n\t\treturn ", length);
+			else
+				fputs("\n\t\t\t|| ", out);
+
+			fprintf(out, "memcmp(text, ");
+			emit_string(out, spec->keywords[i], length);
+			fprintf(out, ", %zu) == 0", length);
+			any = true;
+		}
+
+		if (any)
+			fputs(";\n", out);
+	}
+
+	fputs("\t(void) text;\n\t(void) length;\n\treturn false;\n}\n\n", out);
+}
+
+static void emit_rules(FILE *out, const char *name, const struct TokenSpec *spec) {
+	emit(out, name, "static const unsigned char @_rule_kinds[] = {\n");
+	for (size_t i = 0; i < spec->entries_length; i++) {
+		const char *kind = "OPERATOR";
+		if (spec->entries[i].kind == SPEC_ENTRY_LINE_COMMENT)
+			kind = "LINE_COMMENT";
+		else if (spec->entries[i].kind == SPEC_ENTRY_BLOCK_COMMENT)
+			kind = "BLOCK_COMMENT";
+		fprintf(out, "\t%s_RULE_%s,\n", name, kind);
+	}
+	fputs("\t0\n};\n\n", out);
+
+	emit(out, name, "static const unsigned char @_rule_types[] = {\n");
+	for (size_t i = 0; i < spec->entries_length; i++)
+		fprintf(out, "\t%s,\n", token_type_name(spec->entries[i].type));
+	fputs("\t0\n};\n\n", out);
+
+	emit(out, name, "static const char *const @_rule_closes[] = {\n");
+	for (size_t i = 0; i < spec->entries_length; i++) {
+		fputc('\t', out);
+		if (spec->entries[i].close != NULL)
+			emit_string(out, spec->entries[i].close, spec->entries[i].close_length);
+		else
+			fputs("NULL", out);
+		fputs(",\n", out);
+	}
+	fputs("\tNULL\n};\n\n", out);
+
+	emit(out, name, "static const unsigned int @_rule_close_lengths[] = {\n");
+	for (size_t i = 0; i < spec->entries_length; i++)
+		fprintf(out, "\t%u,\n", spec->entries[i].close_length);
+	fputs("\t0\n};\n\n", out);
+}
+
+// SSE2 compares against each stop byte, as immediates
+static void emit_stops(FILE *out, const unsigned char *stops) {
+	bool first = true;
+	for (int c = 0; c < 256; c++) {
+		if (! stops[c])
+			continue;
+
+		if (first)
+			fputs("\t\t__m128i stop = _mm_cmpeq_epi8(block, _mm_set1_epi8(", out);
+		else
+			fputs("\t\tstop = _mm_or_si128(stop, _mm_cmpeq_epi8(block, _mm_set1_epi8(", out);
+		emit_byte(out, (unsigned char) c, true);
+		fputs(first ? "));\n" : ")));\n", out);
+		first = false;
+	}
+}
+
+static void emit_run(FILE *out, const char *name, const char *which, const unsigned char *stops) {
+	fprintf(out, "static inline size_t %s_run_%s(const char *data, size_t length, struct TokenMetadata *metadata) {\n", name, which);
+	fputs("\tsize_t index = 0;\n\tunsigned int digits = 0;\n\tunsigned int dots = 0;\n", out);
+	fputs("#ifdef __SSE2__\n", out);
+	fputs("\tconst __m128i zero = _mm_set1_epi8('0');\n\tconst __m128i nine = _mm_set1_epi8(9);\n\tconst __m128i dot = _mm_set1_epi8('.');\n", out);
+	fputs("\twhile (index + 16 <= length) {\n\t\t__m128i block = _mm_loadu_si128((const __m128i*) (data + index));\n", out);
+	emit_stops(out, stops);
+	emit(out, name,
+		"\t\t__m128i shifted = _mm_sub_epi8(block, zero);\n"
+		"\t\tunsigned int digit_mask = (unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(shifted, nine), shifted));\n"
+		"\t\tunsigned int dot_mask = (unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(block, dot));\n"
+		"\t\tunsigned int stop_mask = (unsigned int) _mm_movemask_epi8(stop);\n"
+		"\t\tif (stop_mask != 0) {\n"
+		"\t\t\tunsigned int keep = (1u << __builtin_ctz(stop_mask)) - 1;\n"
+		"\t\t\tdigit_mask &= keep;\n"
+		"\t\t\tdot_mask &= keep;\n"
+		"\t\t}\n"
+		"\n"
+		"\t\tdigits += (unsigned int) __builtin_popcount(digit_mask);\n"
+		"\t\tdots += (unsigned int) __builtin_popcount(dot_mask);\n"
+		"\t\tif (stop_mask != 0) {\n"
+		"\t\t\tindex += (unsigned int) __builtin_ctz(stop_mask);\n"
+		"\t\t\tmetadata->numeric_digits += digits;\n"
+		"\t\t\tmetadata->dots += dots;\n"
+		"\t\t\treturn index;\n"
+		"\t\t}\n"
+		"\t\tindex += 16;\n"
+		"\t}\n"
+		"#endif\n"
+		"\n");
+	fputs("\twhile (index < length) {\n\t\tunsigned char c = (unsigned char) data[index];\n\t\tif (", out);
+	bool first = true;
+	for (int c = 0; c < 256; c++) {
+		if (! stops[c])
+			continue;
+
+		if (! first)
+			fputs(" || ", out);
+		fputs("c == ", out);
+		emit_byte(out, (unsigned char) c, false);
+		first = false;
+	}
+	fputs(")\n\t\t\tbreak;\n\n", out);
+	fputs("\t\tdigits += (unsigned int) (c - '0') < 10;\n\t\tdots += c == '.';\n\t\tindex++;\n\t}\n\n", out);
+	fputs("\tmetadata->numeric_digits += digits;\n\tmetadata->dots += dots;\n\treturn index;\n}\n\n", out);
+}
+
+// Everything that does not depend on the spec
+static const char *scanner_template =
+	"enum @_Next {\n"
+	"\t@_NEXT_WORD,\n"
+	"\t@_NEXT_START,\n"
+	"\t@_NEXT_SAME\n"
+	"};\n"
+	"\n"
+	"struct @_State {\n"
+	"\tstruct Token *tokens;\n"
+	"\tsize_t length;\n"
+	"\tsize_t capacity;\n"
+	"};\n"
+	"\n"
+	"static inline void @_lex(struct Token *token, const char *text) {\n"
+	"\tstruct TokenMetadata *metadata = &(token->metadata);\n"
+	"\tif (metadata->numeric_digits == token->value_length) {\n"
+	"\t\ttoken->type = TOKEN_TYPE_INTEGER_LITERAL;\n"
+	"\t\tmetadata->numeric_overflow = ! number_parse_integer(text, token->value_length, &(token->number.integer));\n"
+	"\t\treturn;\n"
+	"\t}\n"
+	"\n"
+	"\tif (metadata->dots == 1 && metadata->numeric_digits == token->value_length - 1) {\n"
+	"\t\ttoken->type = TOKEN_TYPE_FLOAT_LITERAL;\n"
+	"\t\tmetadata->numeric_overflow = ! number_parse_float(text, token->value_length, &(token->number.real));\n"
+	"\t\treturn;\n"
+	"\t}\n"
+	"\n"
+	"\tif (@_keyword(text, token->value_length)) {\n"
+	"\t\ttoken->type = TOKEN_TYPE_KEYWORD;\n"
+	"\t\treturn;\n"
+	"\t}\n"
+	"\n"
+	"\tunsigned char first = (unsigned char) text[0];\n"
+	"\tif (first == '_' || (first >= 'a' && first <= 'z') || (first >= 'A' && first <= 'Z'))\n"
+	"\t\ttoken->type = TOKEN_TYPE_IDENTIFIER;\n"
+	"}\n"
+	"\n"
+	"// Closes the token being read and returns the next one\n"
+	"static inline struct Token* @_advance(struct @_State *state, const char *data) {\n"
+	"\tstruct Token *current = &(state->tokens[state->length]);\n"
+	"\tif (current->type == TOKEN_TYPE_NONE && current->value_length > 0)\n"
+	"\t\t@_lex(current, data + current->offset);\n"
+	"\n"
+	"\treturn tokens_advance(&(state->tokens), &(state->length), &(state->capacity));\n"
+	"}\n"
+	"\n"
+	"static const char* @_find(const char *data, size_t data_length, const char *needle, size_t needle_length) {\n"
+	"\tconst char *end = data + data_length;\n"
+	"\twhile ((size_t) (end - data) >= needle_length) {\n"
+	"\t\tconst char *candidate = memchr(data, needle[0], (size_t) (end - data) - needle_length + 1);\n"
+	"\t\tif (candidate == NULL)\n"
+	"\t\t\treturn NULL;\n"
+	"\n"
+	"\t\tif (memcmp(candidate, needle, needle_length) == 0)\n"
+	"\t\t\treturn candidate;\n"
+	"\n"
+	"\t\tdata = candidate + 1;\n"
+	"\t}\n"
+	"\n"
+	"\treturn NULL;\n"
+	"}\n"
+	"\n"
+	"// The longest operator or comment at `index`. Returns where the scanner\n"
+	"// goes next, or -1 on failure.\n"
+	"static inline int @_special(struct @_State *state, const char *data, size_t data_length, size_t index, size_t *consumed) {\n"
+	"\tstruct Token *current = &(state->tokens[state->length]);\n"
+	"\tsize_t rule = 0;\n"
+	"\tsize_t matched = @_match((const unsigned char*) data + index, data_length - index, &rule);\n"
+	"\n"
+	"\t// Case 1: The byte only starts longer operators, so it is ordinary\n"
+	"\tif (matched == 0) {\n"
+	"\t\tunsigned char c = (unsigned char) data[index];\n"
+	"\t\tif (current->value_length == 0)\n"
+	"\t\t\tcurrent->offset = index;\n"
+	"\t\tcurrent->value_length++;\n"
+	"\t\tcurrent->metadata.numeric_digits += (unsigned int) (c - '0') < 10;\n"
+	"\t\tcurrent->metadata.dots += c == '.';\n"
+	"\t\t(*consumed) = 1;\n"
+	"\t\treturn @_NEXT_WORD;\n"
+	"\t}\n"
+	"\n"
+	"\tif (current->value_length > 0) {\n"
+	"\t\tcurrent = @_advance(state, data);\n"
+	"\t\tif (current == NULL)\n"
+	"\t\t\treturn -1;\n"
+	"\t}\n"
+	"\n"
+	"\t// Case 2: An operator\n"
+	"\tif (@_rule_kinds[rule] == @_RULE_OPERATOR) {\n"
+	"\t\tcurrent->type = (enum TokenType) @_rule_types[rule];\n"
+	"\t\tcurrent->symbol = (uint32_t) rule;\n"
+	"\t\tcurrent->offset = index;\n"
+	"\t\tcurrent->value_length = (unsigned int) matched;\n"
+	"\t\tif (@_advance(state, data) == NULL)\n"
+	"\t\t\treturn -1;\n"
+	"\n"
+	"\t\t(*consumed) = matched;\n"
+	"\t\treturn @_NEXT_SAME;\n"
+	"\t}\n"
+	"\n"
+	"\t// Case 3: A comment, skipped like whitespace\n"
+	"\tconst char *body = data + index + matched;\n"
+	"\tsize_t body_length = data_length - index - matched;\n"
+	"\tconst char *end = NULL;\n"
+	"\tif (@_rule_kinds[rule] == @_RULE_LINE_COMMENT) {\n"
+	"\t\tend = memchr(body, '\\n', body_length);\n"
+	"\t\tif (end != NULL)\n"
+	"\t\t\tend++;\n"
+	"\t}\n"
+	"\telse {\n"
+	"\t\tend = @_find(body, body_length, @_rule_closes[rule], @_rule_close_lengths[rule]);\n"
+	"\t\tif (end != NULL)\n"
+	"\t\t\tend += @_rule_close_lengths[rule];\n"
+	"\t}\n"
+	"\n"
+	"\t(*consumed) = (end != NULL) ? (size_t) (end - (data + index)) : data_length - index;\n"
+	"\treturn @_NEXT_START;\n"
+	"}\n"
+	"\n"
+	"struct Token* @_tokenize(char *data, size_t data_length, size_t *tokens_length, size_t *tokens_capacity) {\n"
+	"\tif (data == NULL || tokens_length == NULL || tokens_capacity == NULL) {\n"
+	"\t\tLOG_ERROR(\"Provided arguments to @_tokenize() are NULL pointers.\\n\");\n"
+	"\t\treturn NULL;\n"
+	"\t}\n"
+	"\n"
+	"\tstruct @_State state;\n"
+	"\tstate.capacity = tokens_estimate(data, data_length) + 1;\n"
+	"\tstate.length = 0;\n"
+	"\tstate.tokens = malloc(sizeof(struct Token) * state.capacity);\n"
+	"\tif (state.tokens == NULL) {\n"
+	"\t\tLOG_ERROR(\"Failed to allocate a tokens buffer of %zu tokens.\\n\", state.capacity);\n"
+	"\t\treturn NULL;\n"
+	"\t}\n"
+	"\ttokens_init(state.tokens, 1);\n"
+	"\n"
+	"\tstruct Token *current = state.tokens;\n"
+	"\tsize_t index = 0;\n"
+	"\tsize_t run = 0;\n"
+	"\tint next = 0;\n"
+	"\tbool escaped = false;\n"
+	"\n"
+	"\t// What to do with the next byte in each state, by its class\n"
+	"\tstatic const void *const start[] = { &&run_word, &&skip, &&extend_word_escaped, &&open_string, &&special, &&done };\n"
+	"\tstatic const void *const start_escaped[] = { &&run_word, &&skip, &&extend_word, &&open_string_escaped, &&special_escaped, &&done };\n"
+	"\tstatic const void *const word[] = { &&run_word, &&close, &&extend_word_escaped, &&open_string, &&special, &&done };\n"
+	"\tstatic const void *const word_escaped[] = { &&run_word, &&close, &&extend_word, &&open_string_escaped, &&special_escaped, &&done };\n"
+	"\tstatic const void *const string[] = { &&run_string, &&run_string, &&extend_string_escaped, &&close, &&run_string, &&done };\n"
+	"\tstatic const void *const string_escaped[] = { &&run_string, &&run_string, &&extend_string, &&extend_string, &&extend_string_escaped, &&done };\n"
+	"#define @_DISPATCH(table) \\\n"
+	"\tif (index >= data_length) \\\n"
+	"\t\tgoto done; \\\n"
+	"\tgoto *table[@_classes[(unsigned char) data[index]]]\n"
+	"\n"
+	"state_start:\n"
+	"\t@_DISPATCH(start);\n"
+	"state_start_escaped:\n"
+	"\t@_DISPATCH(start_escaped);\n"
+	"state_word:\n"
+	"\t@_DISPATCH(word);\n"
+	"state_word_escaped:\n"
+	"\t@_DISPATCH(word_escaped);\n"
+	"state_string:\n"
+	"\t@_DISPATCH(string);\n"
+	"state_string_escaped:\n"
+	"\t@_DISPATCH(string_escaped);\n"
+	"#undef @_DISPATCH\n"
+	"\n"
+	"run_word:\n"
+	"\trun = @_run_outside(data + index, data_length - index, &(current->metadata));\n"
+	"\tif (run == 0)\n"
+	"\t\trun = 1;\n"
+	"\tif (current->value_length == 0)\n"
+	"\t\tcurrent->offset = index;\n"
+	"\tcurrent->value_length += (unsigned int) run;\n"
+	"\tindex += run;\n"
+	"\tgoto state_word;\n"
+	"\n"
+	"run_string:\n"
+	"\trun = @_run_inside(data + index, data_length - index, &(current->metadata));\n"
+	"\tif (run == 0)\n"
+	"\t\trun = 1;\n"
+	"\tif (current->value_length == 0)\n"
+	"\t\tcurrent->offset = index;\n"
+	"\tcurrent->value_length += (unsigned int) run;\n"
+	"\tindex += run;\n"
+	"\tgoto state_string;\n"
+	"\n"
+	"#define @_EXTEND \\\n"
+	"\tif (current->value_length == 0) \\\n"
+	"\t\tcurrent->offset = index; \\\n"
+	"\tcurrent->value_length++; \\\n"
+	"\tindex++\n"
+	"extend_word:\n"
+	"\t@_EXTEND;\n"
+	"\tgoto state_word;\n"
+	"extend_word_escaped:\n"
+	"\t@_EXTEND;\n"
+	"\tgoto state_word_escaped;\n"
+	"extend_string:\n"
+	"\t@_EXTEND;\n"
+	"\tgoto state_string;\n"
+	"extend_string_escaped:\n"
+	"\t@_EXTEND;\n"
+	"\tgoto state_string_escaped;\n"
+	"#undef @_EXTEND\n"
+	"\n"
+	"skip:\n"
+	"\tindex += classify_whitespace_run(data + index, data_length - index);\n"
+	"\tgoto state_start;\n"
+	"\n"
+	"close:\n"
+	"\tcurrent = @_advance(&state, data);\n"
+	"\tif (current == NULL)\n"
+	"\t\tgoto failed;\n"
+	"\tindex++;\n"
+	"\tgoto state_start;\n"
+	"\n"
+	"open_string:\n"
+	"\tescaped = false;\n"
+	"\tgoto open_string_common;\n"
+	"open_string_escaped:\n"
+	"\tescaped = true;\n"
+	"open_string_common:\n"
+	"\tif (current->value_length > 0) {\n"
+	"\t\tcurrent = @_advance(&state, data);\n"
+	"\t\tif (current == NULL)\n"
+	"\t\t\tgoto failed;\n"
+	"\t}\n"
+	"\n"
+	"\tcurrent->type = TOKEN_TYPE_STRING_LITERAL;\n"
+	"\tcurrent->offset = index + 1;\n"
+	"\tindex++;\n"
+	"\tif (escaped)\n"
+	"\t\tgoto state_string_escaped;\n"
+	"\tgoto state_string;\n"
+	"\n"
+	"special:\n"
+	"\tescaped = false;\n"
+	"\tgoto special_common;\n"
+	"special_escaped:\n"
+	"\tescaped = true;\n"
+	"special_common:\n"
+	"\tnext = @_special(&state, data, data_length, index, &run);\n"
+	"\tif (next < 0)\n"
+	"\t\tgoto failed;\n"
+	"\n"
+	"\tcurrent = &(state.tokens[state.length]);\n"
+	"\tindex += run;\n"
+	"\tif (next == @_NEXT_WORD)\n"
+	"\t\tgoto state_word;\n"
+	"\tif (next == @_NEXT_SAME && escaped)\n"
+	"\t\tgoto state_start_escaped;\n"
+	"\tgoto state_start;\n"
+	"\n"
+	"done:\n"
+	"\tif (current->value_length > 0 || current->type != TOKEN_TYPE_NONE) {\n"
+	"\t\tif (@_advance(&state, data) == NULL)\n"
+	"\t\t\tgoto failed;\n"
+	"\t}\n"
+	"\n"
+	"\t(*tokens_length) = state.length;\n"
+	"\t(*tokens_capacity) = state.capacity;\n"
+	"\treturn state.tokens;\n"
+	"\n"
+	"failed:\n"
+	"\ttokens_destroy(state.tokens, state.length);\n"
+	"\treturn NULL;\n"
+	"}\n";
+
+int main(int argc, char **argv) {
+	if (argc != 3) {
+		printf("Usage: generate SPEC NAME\n");
+		return 1;
+	}
+
+	const char *name = argv[2];
+	bool valid = isalpha((unsigned char) name[0]) || name[0] == '_';
+	for (size_t i = 0; name[i] != '\0'; i++)
+		valid = valid && (isalnum((unsigned char) name[i]) || name[i] == '_');
+	if (! valid) {
+		fprintf(stderr, "\"%s\" is not a valid C identifier.\n", name);
+		return 1;
+	}
+
+	struct TokenSpec *spec = spec_load(argv[1]);
+	if (spec == NULL) {
+		fprintf(stderr, "Failed to load the spec \"%s\".\n", argv[1]);
+		return 1;
+	}
+
+	size_t path_length = strlen(name) + 3;
+	char *header_path = malloc(path_length);
+	char *source_path = malloc(path_length);
+	if (header_path == NULL || source_path == NULL) {
+		fprintf(stderr, "Failed to allocate the output paths.\n");
+		free(header_path);
+		free(source_path);
+		spec_destroy(spec);
+		return 1;
+	}
+	snprintf(header_path, path_length, "%s.h", name);
+	snprintf(source_path, path_length, "%s.c", name);
+
+	FILE *header = fopen(header_path, "w");
+	FILE *source = fopen(source_path, "w");
+	if (header == NULL || source == NULL) {
+		fprintf(stderr, "Failed to create \"%s\" and \"%s\".\n", header_path, source_path);
+		if (header != NULL)
+			fclose(header);
+		if (source != NULL)
+			fclose(source);
+		free(header_path);
+		free(source_path);
+		spec_destroy(spec);
+		return 1;
+	}
+
+	// The header
+	fprintf(header, "// Generated by `build generate` from \"%s\". Do not edit.\n", argv[1]);
+	fputs("#ifndef ", header);
+	for (size_t i = 0; name[i] != '\0'; i++)
+		fputc(toupper((unsigned char) name[i]), header);
+	fputs("_H\n#define ", header);
+	for (size_t i = 0; name[i] != '\0'; i++)
+		fputc(toupper((unsigned char) name[i]), header);
+	fputs("_H\n#include \"tokenizer.h\"\n\n", header);
+	emit(header, name,
+		"// Same as tokenize_with_spec() with the spec this was generated from.\n"
+		"// Free the tokens with tokens_destroy().\n"
+		"struct Token* @_tokenize(char *data, size_t data_length, size_t *tokens_length, size_t *tokens_capacity);\n"
+		"#endif\n");
+
+	// The class of every byte, as tokenizer_use_spec() sets them up
+	unsigned char classes[256] = {0};
+	unsigned char outside_stops[256] = {0};
+	unsigned char inside_stops[256] = {0};
+	classes['\t'] = CLASS_WHITESPACE;
+	classes['\n'] = CLASS_WHITESPACE;
+	classes[' '] = CLASS_WHITESPACE;
+	classes['\\'] = CLASS_BACKSLASH;
+	classes['"'] = CLASS_QUOTE;
+	classes[0xFF] = CLASS_EOF;
+	for (int c = 0; c < 256; c++) {
+		if (classes[c] == CLASS_ORDINARY && spec->starts[c])
+			classes[c] = CLASS_SPECIAL;
+
+		outside_stops[c] = classes[c] != CLASS_ORDINARY;
+		inside_stops[c] = classes[c] == CLASS_BACKSLASH || classes[c] == CLASS_QUOTE || classes[c] == CLASS_EOF;
+	}
+
+	// The scanner
+	fprintf(source, "// Generated by `build generate` from \"%s\". Do not edit.\n", argv[1]);
+	emit(source, name,
+		"#include <stdio.h>\n"
+		"#include <stdlib.h>\n"
+		"#include <string.h>\n"
+		"#include <stdbool.h>\n"
+		"#include \"@.h\"\n"
+		"#include \"classify.h\"\n"
+		"#include \"number.h\"\n"
+		"#include \"log.h\"\n"
+		"#ifdef __SSE2__\n"
+		"#include <emmintrin.h>\n"
+		"#endif\n"
+		"\n"
+		"enum @_Class {\n"
+		"\t@_CLASS_ORDINARY,\n"
+		"\t@_CLASS_WHITESPACE,\n"
+		"\t@_CLASS_BACKSLASH,\n"
+		"\t@_CLASS_QUOTE,\n"
+		"\t@_CLASS_SPECIAL,\n"
+		"\t@_CLASS_EOF\n"
+		"};\n"
+		"\n"
+		"enum @_RuleKind {\n"
+		"\t@_RULE_OPERATOR,\n"
+		"\t@_RULE_LINE_COMMENT,\n"
+		"\t@_RULE_BLOCK_COMMENT\n"
+		"};\n"
+		"\n");
+	emit_classes(source, name, classes);
+	emit_rules(source, name, spec);
+	emit_keywords(source, name, spec);
+
+	emit(source, name, "// The longest operator or comment opener at the start of `text`\n");
+	emit(source, name, "static inline size_t @_match(const unsigned char *text, size_t length, size_t *rule) {\n\tsize_t matched = 0;\n");
+	emit_trie(source, spec, 0, 0);
+	fputs("\t(void) text;\n\t(void) length;\n\t(void) rule;\n\treturn matched;\n}\n\n", source);
+
+	emit_run(source, name, "outside", outside_stops);
+	emit_run(source, name, "inside", inside_stops);
+	emit(source, name, scanner_template);
+
+	// Both are closed no matter what, then either failing fails the run
+	int header_status = fclose(header);
+	int source_status = fclose(source);
+	int status = EXIT_SUCCESS;
+	if (header_status != 0 || source_status != 0) {
+		fprintf(stderr, "Failed to write \"%s\" and \"%s\".\n", header_path, source_path);
+		status = EXIT_FAILURE;
+	}
+
+	free(header_path);
+	free(source_path);
+	spec_destroy(spec);
+	return (status == EXIT_SUCCESS) ? 0 : 1;
+}
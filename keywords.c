@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "keywords.h"
+#include "log.h"
+#define KEYWORDS_MAX_SEED_ATTEMPTS 100000
+
+static const char *default_keywords[] = {
+	"int",
+	"float",
+	"field",
+	"constrain",
+	"of",
+	"is",
+	"size",
+	"on"
+};
+
+static struct KeywordTable *default_table = NULL;
+static pthread_once_t default_table_once = PTHREAD_ONCE_INIT;
+
+// Tries to place every keyword in its own slot with the table's current
+// seed and size
+static bool keywords_place(struct KeywordTable *table, const struct Keyword *words, size_t count) {
+	size_t size = (size_t) 1 << table->bits;
+	for (size_t i = 0; i < size; i++) {
+		table->slots[i].text = NULL;
+		table->slots[i].length = 0;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		unsigned int slot = keywords_slot(table, keywords_key(table, words[i].text, words[i].length));
+		if (table->slots[slot].text != NULL) {
+			// The same word twice is fine, it just needs one slot
+			if (table->slots[slot].length == words[i].length && memcmp(table->slots[slot].text, words[i].text, words[i].length) == 0)
+				continue;
+
+			return false;
+		}
+
+		table->slots[slot] = words[i];
+	}
+
+	return true;
+}
+
+// Whether no two different keywords share a key. Only the ends and middle
+// keys can be checked up front, since they do not depend on the seed; if
+// two words share one, no seed can place them.
+static bool keywords_distinct(const struct KeywordTable *table, const struct Keyword *words, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		uint32_t key = keywords_key(table, words[i].text, words[i].length);
+		for (size_t j = i + 1; j < count; j++) {
+			if (keywords_key(table, words[j].text, words[j].length) != key)
+				continue;
+
+			if (words[i].length != words[j].length || memcmp(words[i].text, words[j].text, words[i].length) != 0)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+// Searches for a seed that gives every keyword a distinct slot. The table
+// starts at the smallest power of two that fits and doubles if no seed is 
+// found, so it is as small as it can be while keeping lookups to a shift.
+static int keywords_search(struct KeywordTable *table, const struct Keyword *words, size_t count) {
+	if (table->key != KEYWORDS_KEY_WORD && !keywords_distinct(table, words, count))
+		return EXIT_FAILURE;
+
+	unsigned int bits = 1;
+	while (((size_t) 1 << bits) < count)
+		bits++;
+
+	for (; bits <= 16; bits++) {
+		void *realloc_ptr = realloc(table->slots, sizeof(struct Keyword) * ((size_t) 1 << bits));
+		if (realloc_ptr == NULL) {
+			LOG_ERROR("Failed to allocate a keyword table of %zu slots.\n", (size_t) 1 << bits);
+			return EXIT_FAILURE;
+		}
+		table->slots = (struct Keyword*) realloc_ptr;
+		table->bits = bits;
+
+		// Odd multipliers spread the key over the high bits best
+		uint32_t seed = 0x9E3779B1u;
+		for (int attempt = 0; attempt < KEYWORDS_MAX_SEED_ATTEMPTS; attempt++) {
+			table->seed = seed;
+			if (keywords_place(table, words, count))
+				return EXIT_SUCCESS;
+
+			seed = seed * 1664525u + 1013904223u;
+			seed |= 1;
+		}
+	}
+
+	return EXIT_FAILURE;
+}
+
+struct KeywordTable* keywords_create(const char **words, size_t count) {
+	if (words == NULL && count > 0) {
+		LOG_ERROR("Provided argument `const char **words` is a NULL pointer.\n");
+		return NULL;
+	}
+
+	size_t storage_length = 0;
+	for (size_t i = 0; i < count; i++)
+		storage_length += strlen(words[i]);
+
+	struct KeywordTable *table = calloc(1, sizeof(struct KeywordTable));
+	struct Keyword *keywords = malloc(sizeof(struct Keyword) * (count + 1));
+	char *storage = malloc(storage_length + 1);
+	if (table == NULL || keywords == NULL || storage == NULL) {
+		LOG_ERROR("Failed to allocate a keyword table for %zu keywords.\n", count);
+		free(table);
+		free(keywords);
+		free(storage);
+		return NULL;
+	}
+	table->storage = storage;
+
+	// Copy the words next to each other and note the length range
+	size_t used = 0;
+	size_t kept = 0;
+	table->min_length = (unsigned int) -1;
+	table->max_length = 0;
+	for (size_t i = 0; i < count; i++) {
+		size_t length = strlen(words[i]);
+		if (length == 0)
+			continue;
+
+		memcpy(table->storage + used, words[i], length);
+		keywords[kept].text = table->storage + used;
+		keywords[kept].length = (unsigned int) length;
+		used += length;
+		kept++;
+
+		if (length < table->min_length)
+			table->min_length = (unsigned int) length;
+		if (length > table->max_length)
+			table->max_length = (unsigned int) length;
+	}
+
+	// Case 1: Keywords are told apart by length, first and last character.
+	// Case 2: Two keywords share all three (e.g. "int" and "ant"), so the 
+	//         middle character has to be part of the key too.
+	// Case 3: Two keywords share all four (e.g. "read" and "road"), so the
+	//         key is a hash of the whole word.
+	table->key = KEYWORDS_KEY_ENDS;
+	int status = keywords_search(table, keywords, kept);
+	if (status == EXIT_FAILURE) {
+		table->key = KEYWORDS_KEY_MIDDLE;
+		status = keywords_search(table, keywords, kept);
+	}
+	if (status == EXIT_FAILURE) {
+		table->key = KEYWORDS_KEY_WORD;
+		status = keywords_search(table, keywords, kept);
+	}
+
+	free(keywords);
+	if (status == EXIT_FAILURE) {
+		LOG_ERROR("Failed to find a perfect hash for %zu keywords.\n", count);
+		keywords_destroy(table);
+		return NULL;
+	}
+
+	return table;
+}
+
+void keywords_destroy(struct KeywordTable *table) {
+	if (table == NULL) {
+		LOG_ERROR("Provided argument `struct KeywordTable *table` is a NULL pointer.\n");
+		return;
+	}
+
+	free(table->slots);
+	free(table->storage);
+	free(table);
+}
+
+static void keywords_default_build(void) {
+	default_table = keywords_create(default_keywords, sizeof(default_keywords) / sizeof(default_keywords[0]));
+}
+
+const struct KeywordTable* keywords_default(void) {
+	pthread_once(&default_table_once, keywords_default_build);
+	return default_table;
+}
@@ -0,0 +1,82 @@
+#ifndef KEYWORDS_H
+#define KEYWORDS_H
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+struct Keyword {
+	const char *text;
+	unsigned int length;
+};
+
+// What the hash of a word is made of. The table uses the cheapest key that
+// tells its keywords apart.
+enum KeywordsKey {
+	KEYWORDS_KEY_ENDS,      // Length, first and last character
+	KEYWORDS_KEY_MIDDLE,    // The same and the middle character
+	KEYWORDS_KEY_WORD       // Every character (FNV-1a)
+};
+
+// A perfect hash set of keywords. Every keyword gets a slot of its own, 
+// found from the word's length and first and last characters (and, only 
+// if two keywords share all three, its middle character, or, if that is
+// not enough either, all of its characters). A lookup is one multiply, one
+// shift and at most one memcmp, regardless of how many keywords there are.
+struct KeywordTable {
+	struct Keyword *slots;
+	unsigned int bits;
+	uint32_t seed;
+	enum KeywordsKey key;
+
+	// Anything outside this range cannot be a keyword
+	unsigned int min_length;
+	unsigned int max_length;
+
+	// Copies of the keyword strings
+	char *storage;
+};
+
+// Builds a table for `count` keywords. The words are copied.
+struct KeywordTable* keywords_create(const char **words, size_t count);
+void keywords_destroy(struct KeywordTable *table);
+
+// The language's own keywords: int, float, field, constrain, of, is, 
+// size and on. Built on first use and shared by every thread.
+const struct KeywordTable* keywords_default(void);
+
+static inline uint32_t keywords_key(const struct KeywordTable *table, const char *text, unsigned int length) {
+	// The hash starts from the seed, so words whose hashes collide under
+	// one seed can still be told apart under another
+	if (table->key == KEYWORDS_KEY_WORD) {
+		uint32_t hash = 2166136261u ^ table->seed;
+		for (unsigned int i = 0; i < length; i++) {
+			hash ^= (unsigned char) text[i];
+			hash *= 16777619u;
+		}
+
+		return hash;
+	}
+
+	uint32_t key = length
+		| ((uint32_t) (unsigned char) text[0] << 8)
+		| ((uint32_t) (unsigned char) text[length - 1] << 16);
+
+	if (table->key == KEYWORDS_KEY_MIDDLE)
+		key |= (uint32_t) (unsigned char) text[length / 2] << 24;
+
+	return key;
+}
+
+static inline unsigned int keywords_slot(const struct KeywordTable *table, uint32_t key) {
+	return (unsigned int) ((key * table->seed) >> (32 - table->bits));
+}
+
+static inline bool keywords_contains(const struct KeywordTable *table, const char *text, unsigned int length) {
+	if (length < table->min_length || length > table->max_length)
+		return false;
+
+	const struct Keyword *slot = &(table->slots[keywords_slot(table, keywords_key(table, text, length))]);
+	return slot->length == length && memcmp(slot->text, text, length) == 0;
+}
+#endif
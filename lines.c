@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "lines.h"
+#include "classify.h"
+#include "stats.h"
+#include "log.h"
+
+void line_index_init(struct LineIndex *index, const char *data, size_t data_length) {
+	if (index == NULL) {
+		LOG_ERROR("Provided argument `struct LineIndex *index` is a NULL pointer.\n");
+		return;
+	}
+
+	index->data = data;
+	index->data_length = data_length;
+	index->built = false;
+	index->starts = NULL;
+	index->length = 0;
+	index->capacity = 0;
+}
+
+void line_index_destroy(struct LineIndex *index) {
+	if (index == NULL) {
+		LOG_ERROR("Provided argument `struct LineIndex *index` is a NULL pointer.\n");
+		return;
+	}
+
+	free(index->starts);
+	index->starts = NULL;
+	index->length = 0;
+	index->capacity = 0;
+	index->built = false;
+}
+
+// Scans the data in blocks, making sure before each one that there is 
+// room for a line start at every byte of it
+static int line_index_build(struct LineIndex *index) {
+	if (index->data == NULL && index->data_length > 0) {
+		LOG_ERROR("The line index has no data.\n");
+		return EXIT_FAILURE;
+	}
+
+	index->capacity = LINES_BLOCK_SIZE + 1;
+	index->starts = malloc(sizeof(size_t) * index->capacity);
+	if (index->starts == NULL) {
+		LOG_ERROR("Failed to allocate the line index.\n");
+		return EXIT_FAILURE;
+	}
+
+	index->starts[0] = 0;
+	index->length = 1;
+	for (size_t block = 0; block < index->data_length; block += LINES_BLOCK_SIZE) {
+		size_t block_length = index->data_length - block;
+		if (block_length > LINES_BLOCK_SIZE)
+			block_length = LINES_BLOCK_SIZE;
+
+		if (index->length + block_length > index->capacity) {
+			size_t new_capacity = index->capacity * 2;
+			size_t *realloc_pointer = realloc(index->starts, sizeof(size_t) * new_capacity);
+			if (realloc_pointer == NULL) {
+				LOG_ERROR("Failed to grow the line index to %zu lines.\n", new_capacity);
+				line_index_destroy(index);
+				return EXIT_FAILURE;
+			}
+
+			index->starts = realloc_pointer;
+			index->capacity = new_capacity;
+		}
+
+		index->length += classify_line_starts(index->data + block, block_length, block, index->starts + index->length);
+	}
+
+	STATS_ADD(bytes_allocated, sizeof(size_t) * index->capacity);
+	index->built = true;
+	return EXIT_SUCCESS;
+}
+
+int line_index_locate(struct LineIndex *index, size_t offset, size_t *line, size_t *column) {
+	if (index == NULL) {
+		LOG_ERROR("Provided argument `struct LineIndex *index` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (line == NULL) {
+		LOG_ERROR("Provided argument `size_t *line` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (column == NULL) {
+		LOG_ERROR("Provided argument `size_t *column` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (offset > index->data_length) {
+		LOG_ERROR("Offset %zu is past the end of the input (%zu bytes).\n", offset, index->data_length);
+		return EXIT_FAILURE;
+	}
+
+	if (! index->built && line_index_build(index) == EXIT_FAILURE)
+		return EXIT_FAILURE;
+
+	// The last line that starts at or before the offset
+	size_t low = 0;
+	size_t high = index->length;
+	while (high - low > 1) {
+		size_t middle = low + ((high - low) / 2);
+		if (index->starts[middle] <= offset)
+			low = middle;
+		else
+			high = middle;
+	}
+
+	(*line) = low + 1;
+	(*column) = offset - index->starts[low] + 1;
+	return EXIT_SUCCESS;
+}
+
+size_t line_index_count(struct LineIndex *index) {
+	if (index == NULL) {
+		LOG_ERROR("Provided argument `struct LineIndex *index` is a NULL pointer.\n");
+		return 0;
+	}
+
+	if (! index->built && line_index_build(index) == EXIT_FAILURE)
+		return 0;
+
+	return index->length;
+}
+
+void line_index_report_overflow(struct LineIndex *index, FILE *out, const char *path, const struct Token *token) {
+	if (out == NULL || path == NULL || token == NULL) {
+		LOG_ERROR("Provided argument `%s` is a NULL pointer.\n", (out == NULL) ? "FILE *out" : (path == NULL) ? "const char *path" : "const struct Token *token");
+		return;
+	}
+
+	size_t line = 0;
+	size_t column = 0;
+	if (line_index_locate(index, token->offset, &line, &column) == EXIT_FAILURE)
+		return;
+
+	const char *what = (token->type == TOKEN_TYPE_INTEGER_LITERAL) ? "Integer literal does not fit in 64 bits" : "Float literal is out of range";
+	fprintf(out, "%s:%zu:%zu: %s.\n", path, line, column, what);
+}
@@ -0,0 +1,40 @@
+#ifndef LINES_H
+#define LINES_H
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "tokenizer.h"
+#define LINES_BLOCK_SIZE 4096
+
+// Maps byte offsets of an input (e.g. a token's `offset`) to lines and 
+// columns. Nothing is scanned until the first lookup, which records where
+// every line starts in one vectorized pass over the data; each lookup 
+// after that is a binary search. Inputs that never need a location never
+// pay for the index.
+struct LineIndex {
+	const char *data;
+	size_t data_length;
+	bool built;
+
+	// Offset of the first byte of each line; `starts[0]` is always 0
+	size_t *starts;
+	size_t length;
+	size_t capacity;
+};
+
+// `data` must stay valid (and unchanged) while the index is in use
+void line_index_init(struct LineIndex *index, const char *data, size_t data_length);
+void line_index_destroy(struct LineIndex *index);
+
+// The line and column (both from 1, columns in bytes) of the byte at 
+// `offset`. An offset of `data_length` (the end of the input) is allowed.
+int line_index_locate(struct LineIndex *index, size_t offset, size_t *line, size_t *column);
+
+// How many lines the input has: one more than it has newlines, so a 
+// trailing newline starts an empty last line. Builds the index if needed.
+size_t line_index_count(struct LineIndex *index);
+
+// Writes the warning for a numeric literal whose value does not fit to 
+// `out`, as "path:line:column: ..."
+void line_index_report_overflow(struct LineIndex *index, FILE *out, const char *path, const struct Token *token);
+#endif
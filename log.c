@@ -0,0 +1,53 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdarg.h>
+#include "log.h"
+
+int log_level = LOG_LEVEL_ERROR;
+
+static const char *log_level_names[] = {
+	"OFF",
+	"ERROR",
+	"INFO",
+	"DEBUG",
+	"TRACE"
+};
+
+void log_set_level(int level) {
+	if (level < LOG_LEVEL_OFF)
+		level = LOG_LEVEL_OFF;
+
+	// Asking for more than was compiled in is not an error, there is just
+	// nothing more to print.
+	if (level > LOG_LEVEL_TRACE)
+		level = LOG_LEVEL_TRACE;
+
+	log_level = level;
+}
+
+int log_level_from_string(const char *string, int *level) {
+	if (string == NULL || level == NULL)
+		return EXIT_FAILURE;
+
+	for (int i = LOG_LEVEL_OFF; i <= LOG_LEVEL_TRACE; i++) {
+		if (strcasecmp(string, log_level_names[i]) == 0) {
+			(*level) = i;
+			return EXIT_SUCCESS;
+		}
+	}
+
+	return EXIT_FAILURE;
+}
+
+void log_write(int level, const char *function, const char *format, ...) {
+	if (level <= LOG_LEVEL_OFF || level > LOG_LEVEL_TRACE)
+		return;
+
+	va_list arguments;
+	va_start(arguments, format);
+	fprintf(stderr, "[%s] %s: ", function, log_level_names[level]);
+	vfprintf(stderr, format, arguments);
+	va_end(arguments);
+}
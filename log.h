@@ -0,0 +1,52 @@
+#ifndef LOG_H
+#define LOG_H
+#define LOG_LEVEL_OFF   0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_INFO  2
+#define LOG_LEVEL_DEBUG 3
+#define LOG_LEVEL_TRACE 4
+
+// Highest level that is compiled in at all. Release builds drop the DEBUG
+// and TRACE call sites entirely (including their arguments), since some of 
+// them sit inside the per-character loop. Debug builds (-DTOKENIZER_DEBUG)
+// keep every site and filter them at runtime with log_set_level().
+#ifndef LOG_COMPILED_LEVEL
+#ifdef TOKENIZER_DEBUG
+#define LOG_COMPILED_LEVEL LOG_LEVEL_TRACE
+#else
+#define LOG_COMPILED_LEVEL LOG_LEVEL_INFO
+#endif
+#endif
+
+// Current runtime level. Messages above it are skipped without formatting.
+extern int log_level;
+
+void log_set_level(int level);
+
+// Parses "off", "error", "info", "debug" or "trace" into `level`
+int log_level_from_string(const char *string, int *level);
+
+// Writes "[function] LEVEL: message" to stderr
+void log_write(int level, const char *function, const char *format, ...);
+
+#define LOG_AT(level, ...) \
+	do { \
+		if (log_level >= (level)) \
+			log_write((level), __func__, __VA_ARGS__); \
+	} while (0)
+
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+#define LOG_INFO(...)  LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+
+#if LOG_COMPILED_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) do { } while (0)
+#endif
+
+#if LOG_COMPILED_LEVEL >= LOG_LEVEL_TRACE
+#define LOG_TRACE(...) LOG_AT(LOG_LEVEL_TRACE, __VA_ARGS__)
+#else
+#define LOG_TRACE(...) do { } while (0)
+#endif
+#endif
@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "number.h"
+#include "log.h"
+#define NUMBER_MAX_DIGITS 19
+#define NUMBER_STACK_COPY 64
+
+// Powers of ten that are exact in a double
+static const double exact_powers[] = {
+	1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Value of 8 ASCII digits. All eight are turned into one number with three
+// multiplies: first pairs of digits, then pairs of pairs, then the halves.
+static inline uint64_t number_parse_eight(const char *text) {
+	uint64_t chunk;
+	memcpy(&chunk, text, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	chunk -= 0x3030303030303030ull;
+	chunk = (chunk * 10) + (chunk >> 8);
+	chunk = (((chunk & 0x000000FF000000FFull) * (100 + (1000000ull << 32))) + (((chunk >> 16) & 0x000000FF000000FFull) * (1 + (10000ull << 32)))) >> 32;
+	return chunk & 0xFFFFFFFF;
+#else
+	uint64_t value = 0;
+	for (size_t i = 0; i < 8; i++)
+		value = (value * 10) + (uint64_t) (text[i] - '0');
+	return value;
+#endif
+}
+
+bool number_parse_integer(const char *text, size_t length, int64_t *value) {
+	// Leading zeros don't count towards the digits that fit
+	while (length > 1 && text[0] == '0') {
+		text++;
+		length--;
+	}
+
+	// 19 digits always fit in a uint64_t; whether they fit in an int64_t
+	// is checked at the end
+	if (length > NUMBER_MAX_DIGITS) {
+		(*value) = INT64_MAX;
+		return false;
+	}
+
+	uint64_t result = 0;
+	size_t index = 0;
+	for (; index + 8 <= length; index += 8)
+		result = (result * 100000000) + number_parse_eight(text + index);
+
+	for (; index < length; index++)
+		result = (result * 10) + (uint64_t) (text[index] - '0');
+
+	if (result > INT64_MAX) {
+		(*value) = INT64_MAX;
+		return false;
+	}
+
+	(*value) = (int64_t) result;
+	return true;
+}
+
+// The slow path: strtod() on a NUL-terminated copy
+static bool number_parse_float_slow(const char *text, size_t length, double *value) {
+	char stack_copy[NUMBER_STACK_COPY];
+	char *copy = (length < NUMBER_STACK_COPY) ? stack_copy : malloc(length + 1);
+	if (copy == NULL) {
+		LOG_ERROR("Failed to allocate %zu bytes to convert a float literal.\n", length + 1);
+		(*value) = 0;
+		return false;
+	}
+
+	memcpy(copy, text, length);
+	copy[length] = '\0';
+	errno = 0;
+	(*value) = strtod(copy, NULL);
+	bool fits = (errno != ERANGE);
+
+	if (copy != stack_copy)
+		free(copy);
+	return fits;
+}
+
+bool number_parse_float(const char *text, size_t length, double *value) {
+	// Gather the significant digits into one integer and count how many
+	// of them came after the dot
+	uint64_t mantissa = 0;
+	size_t significant_digits = 0;
+	int exponent = 0;
+	bool after_dot = false;
+	for (size_t i = 0; i < length; i++) {
+		if (text[i] == '.') {
+			after_dot = true;
+			continue;
+		}
+
+		if (significant_digits == NUMBER_MAX_DIGITS)
+			return number_parse_float_slow(text, length, value);
+
+		mantissa = (mantissa * 10) + (uint64_t) (text[i] - '0');
+		if (mantissa != 0)
+			significant_digits++;
+		if (after_dot)
+			exponent--;
+	}
+
+	// Trailing zeros after the dot only make the division harder
+	while (mantissa != 0 && exponent < 0 && mantissa % 10 == 0) {
+		mantissa /= 10;
+		exponent++;
+	}
+
+	// Case 1: Both the mantissa and the power of ten are exact doubles, so
+	//         the one division is correctly rounded.
+	if (mantissa <= (1ull << 53) && -exponent < (int) (sizeof(exact_powers) / sizeof(exact_powers[0]))) {
+		(*value) = (double) mantissa / exact_powers[-exponent];
+		return true;
+	}
+
+	// Case 2: Too many digits to do it exactly here
+	return number_parse_float_slow(text, length, value);
+}
@@ -0,0 +1,19 @@
+#ifndef NUMBER_H
+#define NUMBER_H
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Converts the text of an integer literal (`length` ASCII digits, not
+// NUL-terminated). Eight digits are converted at a time. Returns false if
+// the value does not fit in an int64_t, in which case `value` is INT64_MAX.
+bool number_parse_integer(const char *text, size_t length, int64_t *value);
+
+// Converts the text of a float literal (digits with exactly one dot, which
+// may come first or last). The result is correctly rounded: literals with
+// up to 15 or so significant digits are converted exactly with a single
+// division, anything longer goes through strtod(). Returns false if the
+// value does not fit in a double (it is then HUGE_VAL, or 0 if it is too
+// small).
+bool number_parse_float(const char *text, size_t length, double *value);
+#endif
@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "source.h"
+#include "log.h"
+#define SOURCE_READ_BLOCK_SIZE (1024 * 1024)
+
+// Reads everything left in `fd` into a heap buffer. `size_hint` is the
+// expected size (0 if unknown, e.g. for a pipe) so regular files are read
+// with a single allocation.
+static int source_read_all(int fd, size_t size_hint, struct Source *source) {
+	// One spare byte lets the read that reports end of file land without
+	// growing the buffer.
+	size_t capacity = (size_hint > 0) ? size_hint + 1 : SOURCE_READ_BLOCK_SIZE;
+	size_t length = 0;
+	char *data = malloc(capacity);
+	if (data == NULL) {
+		LOG_ERROR("Failed to allocate %zu bytes for the input.\n", capacity);
+		return EXIT_FAILURE;
+	}
+
+	ssize_t bytes_read;
+	void *realloc_ptr = NULL;
+	while (1) {
+		if (length == capacity) {
+			capacity *= 2;
+			realloc_ptr = realloc(data, capacity);
+			if (realloc_ptr == NULL) {
+				LOG_ERROR("Failed to grow the input buffer to %zu bytes.\n", capacity);
+				free(data);
+				return EXIT_FAILURE;
+			}
+			data = (char*) realloc_ptr;
+		}
+
+		bytes_read = read(fd, data + length, capacity - length);
+		if (bytes_read < 0) {
+			if (errno == EINTR)
+				continue;
+
+			LOG_ERROR("Failed to read the input: %s.\n", strerror(errno));
+			free(data);
+			return EXIT_FAILURE;
+		}
+
+		if (bytes_read == 0)
+			break;
+
+		length += (size_t) bytes_read;
+	}
+
+	source->data = data;
+	source->length = length;
+	source->mapped = false;
+	return EXIT_SUCCESS;
+}
+
+int source_open_fd(int fd, struct Source *source) {
+	if (source == NULL) {
+		LOG_ERROR("Provided argument `struct Source *source` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	source->data = NULL;
+	source->length = 0;
+	source->mapped = false;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0) {
+		LOG_ERROR("Failed to stat the input: %s.\n", strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	// Case 1: Not a regular file (or an empty one), which cannot be mapped.
+	if (! S_ISREG(info.st_mode) || info.st_size == 0)
+		return source_read_all(fd, 0, source);
+
+	// Case 2: Map the file. The tokenizer reads it front to back exactly 
+	//         once, so tell the kernel to read ahead aggressively.
+	size_t length = (size_t) info.st_size;
+	void *mapping = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (mapping == MAP_FAILED) {
+		LOG_INFO("Failed to map the input (%s). Falling back to reading it.\n", strerror(errno));
+		return source_read_all(fd, length, source);
+	}
+	madvise(mapping, length, MADV_SEQUENTIAL);
+
+	source->data = (char*) mapping;
+	source->length = length;
+	source->mapped = true;
+	return EXIT_SUCCESS;
+}
+
+int source_open(const char *path, struct Source *source) {
+	if (path == NULL) {
+		LOG_ERROR("Provided argument `const char *path` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		LOG_ERROR("Failed to open \"%s\": %s.\n", path, strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	int status = source_open_fd(fd, source);
+	close(fd);
+	return status;
+}
+
+void source_close(struct Source *source) {
+	if (source == NULL) {
+		LOG_ERROR("Provided argument `struct Source *source` is a NULL pointer.\n");
+		return;
+	}
+
+	if (source->data == NULL)
+		return;
+
+	if (source->mapped)
+		munmap(source->data, source->length);
+	else
+		free(source->data);
+
+	source->data = NULL;
+	source->length = 0;
+	source->mapped = false;
+}
@@ -0,0 +1,23 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+#include <stddef.h>
+#include <stdbool.h>
+
+// The contents of an input file. Regular files are memory mapped, so `data`
+// points straight at the page cache; anything that cannot be mapped (pipes,
+// character devices, empty files) is read into one heap buffer instead.
+// Either way `data` is NOT NUL-terminated.
+struct Source {
+	char *data;
+	size_t length;
+	bool mapped;
+};
+
+int source_open(const char *path, struct Source *source);
+
+// Same as source_open(), for an already opened file descriptor. The 
+// descriptor is not closed.
+int source_open_fd(int fd, struct Source *source);
+
+void source_close(struct Source *source);
+#endif
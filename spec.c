@@ -0,0 +1,340 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "spec.h"
+#include "log.h"
+
+struct TokenSpec* spec_create(void) {
+	struct TokenSpec *spec = calloc(1, sizeof(struct TokenSpec));
+	if (spec == NULL) {
+		LOG_ERROR("Failed to allocate a token spec.\n");
+		return NULL;
+	}
+
+	return spec;
+}
+
+void spec_destroy(struct TokenSpec *spec) {
+	if (spec == NULL) {
+		LOG_ERROR("Provided argument `struct TokenSpec *spec` is a NULL pointer.\n");
+		return;
+	}
+
+	for (size_t i = 0; i < spec->entries_length; i++) {
+		free(spec->entries[i].text);
+		free(spec->entries[i].close);
+	}
+
+	for (size_t i = 0; i < spec->keywords_length; i++)
+		free(spec->keywords[i]);
+
+	free(spec->entries);
+	free(spec->keywords);
+	free(spec->next);
+	if (spec->keyword_table != NULL)
+		keywords_destroy(spec->keyword_table);
+	free(spec);
+}
+
+int spec_add_keyword(struct TokenSpec *spec, const char *word) {
+	if (spec == NULL) {
+		LOG_ERROR("Provided argument `struct TokenSpec *spec` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (word == NULL) {
+		LOG_ERROR("Provided argument `const char *word` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (spec->compiled) {
+		LOG_ERROR("The spec is already compiled.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (spec->keywords_length == spec->keywords_capacity) {
+		size_t new_capacity = (spec->keywords_capacity == 0) ? 16 : spec->keywords_capacity * 2;
+		char **realloc_pointer = realloc(spec->keywords, sizeof(char*) * new_capacity);
+		if (realloc_pointer == NULL) {
+			LOG_ERROR("Failed to grow the keywords list to %zu entries.\n", new_capacity);
+			return EXIT_FAILURE;
+		}
+
+		spec->keywords = realloc_pointer;
+		spec->keywords_capacity = new_capacity;
+	}
+
+	char *copy = strdup(word);
+	if (copy == NULL) {
+		LOG_ERROR("Failed to copy the keyword \"%s\".\n", word);
+		return EXIT_FAILURE;
+	}
+
+	spec->keywords[spec->keywords_length] = copy;
+	spec->keywords_length++;
+	return EXIT_SUCCESS;
+}
+
+// Bytes that already mean something to the scanner can't be part of an
+// operator or comment delimiter
+static bool spec_text_valid(const char *text) {
+	if (text[0] == '\0')
+		return false;
+
+	for (size_t i = 0; text[i] != '\0'; i++) {
+		unsigned char c = (unsigned char) text[i];
+		if (c == ' ' || c == '\t' || c == '\n' || c == '"' || c == '\\' || c == (unsigned char) EOF)
+			return false;
+	}
+
+	return true;
+}
+
+static int spec_add_entry(struct TokenSpec *spec, enum SpecEntryKind kind, enum TokenType type, const char *text, const char *close) {
+	if (spec->compiled) {
+		LOG_ERROR("The spec is already compiled.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (! spec_text_valid(text)) {
+		LOG_ERROR("\"%s\" cannot be an operator or comment delimiter.\n", text);
+		return EXIT_FAILURE;
+	}
+
+	if (spec->entries_length == SPEC_MAX_ENTRIES) {
+		LOG_ERROR("A spec holds at most %d operators and comment delimiters.\n", SPEC_MAX_ENTRIES);
+		return EXIT_FAILURE;
+	}
+
+	if (spec->entries_length == spec->entries_capacity) {
+		size_t new_capacity = (spec->entries_capacity == 0) ? 16 : spec->entries_capacity * 2;
+		struct SpecEntry *realloc_pointer = realloc(spec->entries, sizeof(struct SpecEntry) * new_capacity);
+		if (realloc_pointer == NULL) {
+			LOG_ERROR("Failed to grow the spec entries to %zu entries.\n", new_capacity);
+			return EXIT_FAILURE;
+		}
+
+		spec->entries = realloc_pointer;
+		spec->entries_capacity = new_capacity;
+	}
+
+	struct SpecEntry *entry = &(spec->entries[spec->entries_length]);
+	entry->kind = kind;
+	entry->type = type;
+	entry->length = (unsigned int) strlen(text);
+	entry->text = strdup(text);
+	entry->close = (close != NULL) ? strdup(close) : NULL;
+	entry->close_length = (close != NULL) ? (unsigned int) strlen(close) : 0;
+	if (entry->text == NULL || (close != NULL && entry->close == NULL)) {
+		LOG_ERROR("Failed to copy the spec entry \"%s\".\n", text);
+		free(entry->text);
+		free(entry->close);
+		return EXIT_FAILURE;
+	}
+
+	spec->entries_length++;
+	return EXIT_SUCCESS;
+}
+
+int spec_add_operator(struct TokenSpec *spec, const char *text, enum TokenType type) {
+	if (spec == NULL) {
+		LOG_ERROR("Provided argument `struct TokenSpec *spec` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (text == NULL) {
+		LOG_ERROR("Provided argument `const char *text` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (type == TOKEN_TYPE_NONE || type >= TOKEN_TYPE_COUNT) {
+		LOG_ERROR("Operator \"%s\" has an invalid type (%d).\n", text, (int) type);
+		return EXIT_FAILURE;
+	}
+
+	return spec_add_entry(spec, SPEC_ENTRY_OPERATOR, type, text, NULL);
+}
+
+int spec_add_comment(struct TokenSpec *spec, const char *open, const char *close) {
+	if (spec == NULL) {
+		LOG_ERROR("Provided argument `struct TokenSpec *spec` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (open == NULL) {
+		LOG_ERROR("Provided argument `const char *open` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (close != NULL && close[0] == '\0') {
+		LOG_ERROR("The comment opened by \"%s\" has an empty closing delimiter.\n", open);
+		return EXIT_FAILURE;
+	}
+
+	return spec_add_entry(spec, (close != NULL) ? SPEC_ENTRY_BLOCK_COMMENT : SPEC_ENTRY_LINE_COMMENT, TOKEN_TYPE_NONE, open, close);
+}
+
+int spec_compile(struct TokenSpec *spec) {
+	if (spec == NULL) {
+		LOG_ERROR("Provided argument `struct TokenSpec *spec` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (spec->compiled)
+		return EXIT_SUCCESS;
+
+	// One column per distinct byte; column 0 stands for every other byte
+	memset(spec->byte_columns, 0, sizeof(spec->byte_columns));
+	memset(spec->starts, 0, sizeof(spec->starts));
+	spec->columns = 1;
+	for (size_t i = 0; i < spec->entries_length; i++) {
+		const struct SpecEntry *entry = &(spec->entries[i]);
+		spec->starts[(unsigned char) entry->text[0]] = 1;
+		for (unsigned int j = 0; j < entry->length; j++) {
+			unsigned char c = (unsigned char) entry->text[j];
+			if (spec->byte_columns[c] == 0) {
+				spec->byte_columns[c] = (unsigned char) spec->columns;
+				spec->columns++;
+			}
+		}
+	}
+
+	// Room for the most nodes there can be, trimmed once they are counted
+	spec->next = calloc((size_t) (SPEC_MAX_NODES + 1) * spec->columns, sizeof(uint8_t));
+	if (spec->next == NULL) {
+		LOG_ERROR("Failed to allocate the operator trie.\n");
+		return EXIT_FAILURE;
+	}
+
+	memset(spec->accepts, 0, sizeof(spec->accepts));
+	spec->nodes = 1;
+	for (size_t i = 0; i < spec->entries_length; i++) {
+		const struct SpecEntry *entry = &(spec->entries[i]);
+		size_t node = 0;
+		for (unsigned int j = 0; j < entry->length; j++) {
+			uint8_t *edge = &(spec->next[(node * spec->columns) + spec->byte_columns[(unsigned char) entry->text[j]]]);
+			if ((*edge) == 0) {
+				if (spec->nodes > SPEC_MAX_NODES) {
+					LOG_ERROR("The operators need more than %d trie nodes.\n", SPEC_MAX_NODES);
+					return EXIT_FAILURE;
+				}
+
+				(*edge) = (uint8_t) spec->nodes;
+				spec->nodes++;
+			}
+
+			node = (*edge);
+		}
+
+		if (spec->accepts[node] != 0) {
+			LOG_ERROR("\"%s\" is in the spec more than once.\n", entry->text);
+			return EXIT_FAILURE;
+		}
+
+		spec->accepts[node] = (uint8_t) (i + 1);
+	}
+
+	uint8_t *realloc_pointer = realloc(spec->next, spec->nodes * spec->columns);
+	if (realloc_pointer != NULL)
+		spec->next = realloc_pointer;
+
+	spec->keyword_table = keywords_create((const char**) spec->keywords, spec->keywords_length);
+	if (spec->keyword_table == NULL)
+		return EXIT_FAILURE;
+
+	classify_init(&(spec->classes), spec->starts);
+	spec->compiled = true;
+	return EXIT_SUCCESS;
+}
+
+// Accepts both "EQUALS" and "TOKEN_TYPE_EQUALS"
+static int spec_type_from_name(const char *name, enum TokenType *type) {
+	const char *prefix = "TOKEN_TYPE_";
+	size_t prefix_length = strlen(prefix);
+	for (int i = TOKEN_TYPE_NONE + 1; i < TOKEN_TYPE_COUNT; i++) {
+		const char *full = token_type_name((enum TokenType) i);
+		if (strcmp(name, full) == 0 || strcmp(name, full + prefix_length) == 0) {
+			(*type) = (enum TokenType) i;
+			return EXIT_SUCCESS;
+		}
+	}
+
+	return EXIT_FAILURE;
+}
+
+// Adds the rule on one (non-empty, non-comment) line of a spec file
+static int spec_add_line(struct TokenSpec *spec, char *line) {
+	char *save = NULL;
+	const char *separators = " \t";
+	char *kind = strtok_r(line, separators, &save);
+	char *first = strtok_r(NULL, separators, &save);
+	char *second = strtok_r(NULL, separators, &save);
+	if (kind == NULL || first == NULL || strtok_r(NULL, separators, &save) != NULL)
+		return EXIT_FAILURE;
+
+	if (strcmp(kind, "keyword") == 0 && second == NULL)
+		return spec_add_keyword(spec, first);
+
+	if (strcmp(kind, "operator") == 0) {
+		enum TokenType type = TOKEN_TYPE_OPERATOR;
+		if (second != NULL && spec_type_from_name(second, &type) == EXIT_FAILURE) {
+			LOG_ERROR("Unknown token type \"%s\".\n", second);
+			return EXIT_FAILURE;
+		}
+
+		return spec_add_operator(spec, first, type);
+	}
+
+	if (strcmp(kind, "comment") == 0)
+		return spec_add_comment(spec, first, second);
+
+	return EXIT_FAILURE;
+}
+
+struct TokenSpec* spec_load(const char *path) {
+	if (path == NULL) {
+		LOG_ERROR("Provided argument `const char *path` is a NULL pointer.\n");
+		return NULL;
+	}
+
+	FILE *file = fopen(path, "r");
+	if (file == NULL) {
+		LOG_ERROR("Failed to open the spec \"%s\": %s.\n", path, strerror(errno));
+		return NULL;
+	}
+
+	struct TokenSpec *spec = spec_create();
+	int status = (spec != NULL) ? EXIT_SUCCESS : EXIT_FAILURE;
+	char *line = NULL;
+	size_t line_capacity = 0;
+	ssize_t line_length;
+	size_t line_number = 0;
+	while (status == EXIT_SUCCESS && (line_length = getline(&line, &line_capacity, file)) >= 0) {
+		line_number++;
+		while (line_length > 0 && (line[line_length - 1] == '\n' || line[line_length - 1] == '\r'))
+			line_length--;
+		line[line_length] = '\0';
+
+		size_t skip = strspn(line, " \t");
+		if (line[skip] == '\0' || line[skip] == '#')
+			continue;
+
+		status = spec_add_line(spec, line + skip);
+		if (status == EXIT_FAILURE)
+			LOG_ERROR("Invalid rule on line %zu of the spec \"%s\".\n", line_number, path);
+	}
+
+	free(line);
+	fclose(file);
+	if (status == EXIT_SUCCESS)
+		status = spec_compile(spec);
+
+	if (status == EXIT_FAILURE) {
+		if (spec != NULL)
+			spec_destroy(spec);
+		return NULL;
+	}
+
+	return spec;
+}
@@ -0,0 +1,117 @@
+#ifndef SPEC_H
+#define SPEC_H
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "tokenizer.h"
+#include "keywords.h"
+#include "classify.h"
+#define SPEC_MAX_NODES 255
+#define SPEC_MAX_ENTRIES 255
+
+enum SpecEntryKind {
+	SPEC_ENTRY_OPERATOR,
+	SPEC_ENTRY_LINE_COMMENT,
+	SPEC_ENTRY_BLOCK_COMMENT
+};
+
+// An operator, or the delimiter that opens a comment
+struct SpecEntry {
+	enum SpecEntryKind kind;
+	enum TokenType type;
+	char *text;
+	unsigned int length;
+
+	// Block comments only: what closes them
+	char *close;
+	unsigned int close_length;
+};
+
+// The token rules of one dialect: its operators, keywords and comment
+// delimiters, replacing the built-in special characters and keywords.
+//
+// Operators and comment openers are compiled into one trie, stored as a
+// flat table with a row per node and a column per byte that appears in
+// any of them (`byte_columns` maps bytes to columns, 0 for bytes in
+// none). Walking it costs one load per byte, and for the usual few dozen
+// operators the whole table fits in a handful of cache lines. The scanner
+// takes the longest match, so with "=" and "==" both defined, "a==b" is
+// "a", "==", "b".
+//
+// A spec file has one rule per line. Blank lines and lines starting with
+// '#' are skipped:
+//
+//     keyword  WORD
+//     operator TEXT [TYPE]     TYPE is a token type name, with or without
+//                              the TOKEN_TYPE_ prefix (default OPERATOR)
+//     comment  OPEN [CLOSE]    Without CLOSE, the comment ends at the end
+//                              of the line
+//
+// Operator and comment text cannot contain whitespace, quotes, backslashes
+// or EOF markers.
+struct TokenSpec {
+	struct SpecEntry *entries;
+	size_t entries_length;
+	size_t entries_capacity;
+	char **keywords;
+	size_t keywords_length;
+	size_t keywords_capacity;
+
+	// Filled in by spec_compile()
+	bool compiled;
+	unsigned char byte_columns[256];
+	size_t columns;
+	uint8_t *next;
+	size_t nodes;
+
+	// 1 + the entry a node completes, or 0
+	uint8_t accepts[SPEC_MAX_NODES + 1];
+
+	// Bytes that can start an entry, and the stop sets of the run scanner
+	// for them
+	unsigned char starts[256];
+	struct CharClasses classes;
+	struct KeywordTable *keyword_table;
+};
+
+struct TokenSpec* spec_create(void);
+void spec_destroy(struct TokenSpec *spec);
+
+// Rules are only added before spec_compile(). The text is copied.
+int spec_add_keyword(struct TokenSpec *spec, const char *word);
+int spec_add_operator(struct TokenSpec *spec, const char *text, enum TokenType type);
+
+// A comment from `open` to `close`, or to the end of the line if `close`
+// is NULL
+int spec_add_comment(struct TokenSpec *spec, const char *open, const char *close);
+
+// Builds the trie and the keyword table. The same text added twice is an
+// error.
+int spec_compile(struct TokenSpec *spec);
+
+// Reads and compiles the spec file at `path`
+struct TokenSpec* spec_load(const char *path);
+
+// Longest entry matching the start of `data`: returns its length (0 if
+// none) and leaves the entry's index in `(*entry)`
+static inline size_t spec_match(const struct TokenSpec *spec, const char *data, size_t length, size_t *entry) {
+	size_t node = 0;
+	size_t matched = 0;
+	for (size_t i = 0; i < length; i++) {
+		unsigned char column = spec->byte_columns[(unsigned char) data[i]];
+		if (column == 0)
+			break;
+
+		node = spec->next[(node * spec->columns) + column];
+		if (node == 0)
+			break;
+
+		if (spec->accepts[node] != 0) {
+			matched = i + 1;
+			(*entry) = spec->accepts[node] - 1;
+		}
+	}
+
+	return matched;
+}
+#endif
@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "stats.h"
+#include "tokenizer.h"
+#include "log.h"
+
+_Thread_local struct TokenizerStats *stats_current = NULL;
+
+static const char *stats_phase_names[] = {
+	"read",
+	"scan",
+	"lex"
+};
+
+static double stats_clock(clockid_t clock) {
+	struct timespec time;
+	clock_gettime(clock, &time);
+	return (double) time.tv_sec + (double) time.tv_nsec / 1e9;
+}
+
+struct TokenizerStats* stats_attach(struct TokenizerStats *stats) {
+	struct TokenizerStats *previous = stats_current;
+	stats_current = stats;
+	return previous;
+}
+
+void stats_reset(struct TokenizerStats *stats) {
+	if (stats == NULL) {
+		LOG_ERROR("Provided argument `struct TokenizerStats *stats` is a NULL pointer.\n");
+		return;
+	}
+
+	memset(stats, 0, sizeof(struct TokenizerStats));
+}
+
+void stats_merge(struct TokenizerStats *into, const struct TokenizerStats *from) {
+	if (into == NULL || from == NULL) {
+		LOG_ERROR("Provided argument `struct TokenizerStats *%s` is a NULL pointer.\n", (into == NULL) ? "into" : "from");
+		return;
+	}
+
+	into->bytes_scanned += from->bytes_scanned;
+	into->tokens += from->tokens;
+	for (int i = 0; i < TOKEN_TYPE_COUNT; i++)
+		into->tokens_by_type[i] += from->tokens_by_type[i];
+
+	into->tokens_reallocations += from->tokens_reallocations;
+	into->value_growths += from->value_growths;
+	into->bytes_allocated += from->bytes_allocated;
+	for (int i = 0; i < STATS_PHASE_COUNT; i++) {
+		into->phases[i].wall_seconds += from->phases[i].wall_seconds;
+		into->phases[i].cpu_seconds += from->phases[i].cpu_seconds;
+	}
+}
+
+void stats_timer_start(struct StatsTimer *timer) {
+	timer->running = stats_current != NULL;
+	if (! timer->running)
+		return;
+
+	timer->wall_start = stats_clock(CLOCK_MONOTONIC);
+	timer->cpu_start = stats_clock(CLOCK_PROCESS_CPUTIME_ID);
+}
+
+void stats_timer_stop(struct StatsTimer *timer, enum StatsPhase phase) {
+	if (! timer->running || stats_current == NULL)
+		return;
+
+	struct StatsTime *time = &(stats_current->phases[phase]);
+	time->wall_seconds += stats_clock(CLOCK_MONOTONIC) - timer->wall_start;
+	time->cpu_seconds += stats_clock(CLOCK_PROCESS_CPUTIME_ID) - timer->cpu_start;
+	timer->running = false;
+}
+
+void stats_print(FILE *stream, const struct TokenizerStats *stats) {
+	if (stream == NULL || stats == NULL) {
+		LOG_ERROR("Provided argument `%s` is a NULL pointer.\n", (stream == NULL) ? "FILE *stream" : "const struct TokenizerStats *stats");
+		return;
+	}
+
+	fprintf(stream, "bytes_scanned %zu\n", stats->bytes_scanned);
+	fprintf(stream, "tokens %zu\n", stats->tokens);
+	for (int i = 0; i < TOKEN_TYPE_COUNT; i++) {
+		if (stats->tokens_by_type[i] > 0)
+			fprintf(stream, "tokens.%s %zu\n", token_type_name((enum TokenType) i), stats->tokens_by_type[i]);
+	}
+
+	fprintf(stream, "tokens_reallocations %zu\n", stats->tokens_reallocations);
+	fprintf(stream, "value_growths %zu\n", stats->value_growths);
+	fprintf(stream, "bytes_allocated %zu\n", stats->bytes_allocated);
+	for (int i = 0; i < STATS_PHASE_COUNT; i++) {
+		fprintf(stream, "%s_wall_seconds %.6f\n", stats_phase_names[i], stats->phases[i].wall_seconds);
+		fprintf(stream, "%s_cpu_seconds %.6f\n", stats_phase_names[i], stats->phases[i].cpu_seconds);
+	}
+}
@@ -0,0 +1,70 @@
+#ifndef STATS_H
+#define STATS_H
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "tokenizer.h"
+
+enum StatsPhase {
+	STATS_PHASE_READ,
+	STATS_PHASE_SCAN,
+	STATS_PHASE_LEX,
+	STATS_PHASE_COUNT
+};
+
+struct StatsTime {
+	double wall_seconds;
+	double cpu_seconds;
+};
+
+struct StatsTimer {
+	bool running;
+	double wall_start;
+	double cpu_start;
+};
+
+// Counters for everything the tokenizer does on the threads that attached 
+// this struct. Counters only ever add up; start over with stats_reset().
+// Time spent classifying tokens while scanning is part of the scan phase;
+// the lex phase only covers explicit lex() calls.
+struct TokenizerStats {
+	size_t bytes_scanned;
+	size_t tokens;
+	size_t tokens_by_type[TOKEN_TYPE_COUNT];
+
+	// Growths of a tokens buffer (tokens_advance()) and of an owned token
+	// value (token_add_character())
+	size_t tokens_reallocations;
+	size_t value_growths;
+	size_t bytes_allocated;
+
+	struct StatsTime phases[STATS_PHASE_COUNT];
+};
+
+// Struct the calling thread collects into, or NULL when it collects 
+// nothing. Every counter site checks this first, so leaving statistics off
+// costs one (thread local) load and branch per site.
+extern _Thread_local struct TokenizerStats *stats_current;
+
+#define STATS_ADD(field, amount) \
+	do { \
+		if (stats_current != NULL) \
+			stats_current->field += (amount); \
+	} while (0)
+
+// Makes tokenizer calls on this thread add to `stats` (NULL stops them).
+// Returns the struct that was attached before.
+struct TokenizerStats* stats_attach(struct TokenizerStats *stats);
+void stats_reset(struct TokenizerStats *stats);
+
+// Adds every counter of `from` to `into`
+void stats_merge(struct TokenizerStats *into, const struct TokenizerStats *from);
+
+// Times a phase for the attached struct. Both are no-ops when nothing is 
+// attached.
+void stats_timer_start(struct StatsTimer *timer);
+void stats_timer_stop(struct StatsTimer *timer, enum StatsPhase phase);
+
+// Writes one "name value" line per counter, for scraping into metrics
+void stats_print(FILE *stream, const struct TokenizerStats *stats);
+#endif
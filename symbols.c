@@ -0,0 +1,179 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "symbols.h"
+#include "arena.h"
+#include "log.h"
+#define SYMBOLS_INITIAL_SLOTS 1024
+#define SYMBOLS_STORAGE_CHUNK_SIZE (64 * 1024)
+
+// Hashes eight bytes at a time
+static uint32_t symbols_hash(const char *text, size_t length) {
+	uint64_t hash = 0x9E3779B97F4A7C15ull ^ length;
+	uint64_t word;
+	while (length >= 8) {
+		memcpy(&word, text, 8);
+		hash = (hash ^ word) * 0xFF51AFD7ED558CCDull;
+		hash ^= hash >> 32;
+		text += 8;
+		length -= 8;
+	}
+
+	word = 0;
+	if (length > 0)
+		memcpy(&word, text, length);
+	hash = (hash ^ word) * 0xC4CEB9FE1A85EC53ull;
+	hash ^= hash >> 29;
+	return (uint32_t) hash;
+}
+
+struct SymbolTable* symbols_create(void) {
+	struct SymbolTable *table = malloc(sizeof(struct SymbolTable));
+	if (table == NULL) {
+		LOG_ERROR("Failed to allocate the symbol table.\n");
+		return NULL;
+	}
+
+	table->slots = calloc(SYMBOLS_INITIAL_SLOTS, sizeof(uint32_t));
+	table->slots_count = SYMBOLS_INITIAL_SLOTS;
+	table->symbols = malloc(sizeof(struct Symbol) * (SYMBOLS_INITIAL_SLOTS / 2));
+	table->symbols_length = 0;
+	table->symbols_capacity = SYMBOLS_INITIAL_SLOTS / 2;
+	table->storage = arena_create(SYMBOLS_STORAGE_CHUNK_SIZE);
+	if (table->slots == NULL || table->symbols == NULL || table->storage == NULL) {
+		LOG_ERROR("Failed to allocate the symbol table.\n");
+		symbols_destroy(table);
+		return NULL;
+	}
+
+	return table;
+}
+
+void symbols_destroy(struct SymbolTable *table) {
+	if (table == NULL) {
+		LOG_ERROR("Provided argument `struct SymbolTable *table` is a NULL pointer.\n");
+		return;
+	}
+
+	free(table->slots);
+	free(table->symbols);
+	if (table->storage != NULL)
+		arena_destroy(table->storage);
+	free(table);
+}
+
+// Doubles the slots (and room for symbols), placing every symbol again
+// from its saved hash
+static int symbols_grow(struct SymbolTable *table) {
+	size_t slots_count = table->slots_count * 2;
+	uint32_t *slots = calloc(slots_count, sizeof(uint32_t));
+	struct Symbol *symbols = realloc(table->symbols, sizeof(struct Symbol) * (slots_count / 2));
+	if (slots == NULL || symbols == NULL) {
+		LOG_ERROR("Failed to grow the symbol table to %zu slots.\n", slots_count);
+		free(slots);
+		if (symbols != NULL)
+			table->symbols = symbols;
+		return EXIT_FAILURE;
+	}
+
+	size_t mask = slots_count - 1;
+	for (size_t i = 0; i < table->symbols_length; i++) {
+		size_t slot = symbols[i].hash & mask;
+		while (slots[slot] != SYMBOL_NONE)
+			slot = (slot + 1) & mask;
+
+		slots[slot] = (uint32_t) (i + 1);
+	}
+
+	free(table->slots);
+	table->slots = slots;
+	table->slots_count = slots_count;
+	table->symbols = symbols;
+	table->symbols_capacity = slots_count / 2;
+	return EXIT_SUCCESS;
+}
+
+int symbols_intern(struct SymbolTable *table, const char *text, size_t length, uint32_t *id) {
+	if (table == NULL) {
+		LOG_ERROR("Provided argument `struct SymbolTable *table` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (text == NULL && length > 0) {
+		LOG_ERROR("Provided argument `const char *text` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (id == NULL) {
+		LOG_ERROR("Provided argument `uint32_t *id` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (length > UINT32_MAX) {
+		LOG_ERROR("Cannot intern a string of %zu bytes.\n", length);
+		return EXIT_FAILURE;
+	}
+
+	// Case 1: The string is already in the table
+	uint32_t hash = symbols_hash(text, length);
+	size_t mask = table->slots_count - 1;
+	size_t slot = hash & mask;
+	while (table->slots[slot] != SYMBOL_NONE) {
+		const struct Symbol *symbol = &(table->symbols[table->slots[slot] - 1]);
+		if (symbol->hash == hash && symbol->length == length && memcmp(symbol->text, text, length) == 0) {
+			(*id) = table->slots[slot];
+			return EXIT_SUCCESS;
+		}
+
+		slot = (slot + 1) & mask;
+	}
+
+	// Case 2: The string is new. Copy it and take the empty slot the 
+	//         probe stopped at, unless the table has to grow first.
+	if (table->symbols_length == table->symbols_capacity) {
+		if (symbols_grow(table) == EXIT_FAILURE)
+			return EXIT_FAILURE;
+
+		mask = table->slots_count - 1;
+		slot = hash & mask;
+		while (table->slots[slot] != SYMBOL_NONE)
+			slot = (slot + 1) & mask;
+	}
+
+	char *copy = arena_alloc(table->storage, length + 1);
+	if (copy == NULL) {
+		LOG_ERROR("Failed to allocate %zu bytes for a symbol.\n", length + 1);
+		return EXIT_FAILURE;
+	}
+	memcpy(copy, text, length);
+	copy[length] = '\0';
+
+	struct Symbol *symbol = &(table->symbols[table->symbols_length]);
+	symbol->text = copy;
+	symbol->length = (uint32_t) length;
+	symbol->hash = hash;
+	table->symbols_length++;
+	table->slots[slot] = (uint32_t) table->symbols_length;
+	(*id) = (uint32_t) table->symbols_length;
+	return EXIT_SUCCESS;
+}
+
+const char* symbols_text(const struct SymbolTable *table, uint32_t id, size_t *length) {
+	if (table == NULL) {
+		LOG_ERROR("Provided argument `const struct SymbolTable *table` is a NULL pointer.\n");
+		return NULL;
+	}
+
+	if (id == SYMBOL_NONE || id > table->symbols_length)
+		return NULL;
+
+	const struct Symbol *symbol = &(table->symbols[id - 1]);
+	if (length != NULL)
+		(*length) = symbol->length;
+	return symbol->text;
+}
+
+size_t symbols_count(const struct SymbolTable *table) {
+	return (table != NULL) ? table->symbols_length : 0;
+}
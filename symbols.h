@@ -0,0 +1,47 @@
+#ifndef SYMBOLS_H
+#define SYMBOLS_H
+#include <stddef.h>
+#include <stdint.h>
+#include "arena.h"
+
+// Id of "no symbol". Real ids start at 1.
+#define SYMBOL_NONE 0
+
+struct Symbol {
+	const char *text;
+	uint32_t length;
+	uint32_t hash;
+};
+
+// Interns byte strings: every distinct string is stored once and gets a 
+// small integer id, so equal strings compare as equal ids. Lookups hash the
+// bytes into an open addressing table (linear probing) of ids, which is 
+// kept at most half full.
+struct SymbolTable {
+	// Ids by slot, SYMBOL_NONE for an empty slot
+	uint32_t *slots;
+	size_t slots_count;
+
+	// Symbols by id - 1
+	struct Symbol *symbols;
+	size_t symbols_length;
+	size_t symbols_capacity;
+
+	// NUL-terminated copies of the strings. They never move, so the text
+	// of a symbol stays valid until the table is destroyed.
+	struct Arena *storage;
+};
+
+struct SymbolTable* symbols_create(void);
+void symbols_destroy(struct SymbolTable *table);
+
+// Looks `text` up, adding it if it is new, and stores its id in `id`
+int symbols_intern(struct SymbolTable *table, const char *text, size_t length, uint32_t *id);
+
+// Returns the NUL-terminated text of symbol `id` (and its length in 
+// `length`, when not NULL), or NULL if there is no such symbol
+const char* symbols_text(const struct SymbolTable *table, uint32_t id, size_t *length);
+
+// Number of distinct symbols
+size_t symbols_count(const struct SymbolTable *table);
+#endif
@@ -0,0 +1,16 @@
+# A sample dialect for the "check" build target, which generates a scanner
+# from it and compares that with the one loaded at runtime (see spec.h)
+keyword field
+keyword constrain
+operator ( LEFT_PARENTHESIS
+operator ) RIGHT_PARENTHESIS
+operator = ASSIGNMENT
+operator == EQUALS
+operator <=
+operator <
+operator ->
+operator + PLUS
+operator - MINUS
+operator ...
+comment //
+comment /* */
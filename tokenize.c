@@ -1,79 +1,324 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
 #include "tokenizer.h"
+#include "log.h"
+#include "stats.h"
+#include "cache.h"
+#include "batch.h"
+#include "writer.h"
+#include "lines.h"
+#include "spec.h"
 
 void print_usage() {
-	printf("Usage: tokenizer [SOURCE FILE]\n");
+	printf("Usage: tokenizer [--log-level off|error|info|debug|trace] [--threads N] [--stats] [--format text|json|binary] [--cache-dir DIRECTORY] [--spec FILE] [--manifest FILE] [--directory DIRECTORY] [SOURCE FILE... | -]\n");
 }
 
 int main(int argc, char **argv) {
-	if (argc < 2) {
+	const char *path = NULL;
+	int level = LOG_LEVEL_ERROR;
+	bool parallel = false;
+	size_t threads = 0;
+	bool collect_stats = false;
+	const char *cache_directory = NULL;
+	const char *spec_path = NULL;
+	enum WriterFormat format = WRITER_FORMAT_TEXT;
+	struct BatchPaths batch;
+	batch_paths_init(&batch);
+	bool batch_mode = false;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--log-level") == 0) {
+			if (i + 1 >= argc || log_level_from_string(argv[i + 1], &level) == EXIT_FAILURE) {
+				print_usage();
+				batch_paths_destroy(&batch);
+				return 1;
+			}
+			log_set_level(level);
+			i++;
+		}
+		// 0 threads means one per CPU
+		else if (strcmp(argv[i], "--threads") == 0) {
+			if (i + 1 >= argc) {
+				print_usage();
+				batch_paths_destroy(&batch);
+				return 1;
+			}
+			threads = strtoul(argv[i + 1], NULL, 10);
+			parallel = true;
+			i++;
+		}
+		// Counters and phase timings, written to stderr at the end
+		else if (strcmp(argv[i], "--stats") == 0)
+			collect_stats = true;
+		else if (strcmp(argv[i], "--format") == 0) {
+			if (i + 1 >= argc || writer_format_from_string(argv[i + 1], &format) == EXIT_FAILURE) {
+				print_usage();
+				batch_paths_destroy(&batch);
+				return 1;
+			}
+			i++;
+		}
+		// Tokens of inputs seen before are loaded from here instead
+		else if (strcmp(argv[i], "--cache-dir") == 0) {
+			if (i + 1 >= argc) {
+				print_usage();
+				batch_paths_destroy(&batch);
+				return 1;
+			}
+			cache_directory = argv[i + 1];
+			i++;
+		}
+		// Operators, keywords and comments of a dialect (see spec.h)
+		else if (strcmp(argv[i], "--spec") == 0) {
+			if (i + 1 >= argc) {
+				print_usage();
+				batch_paths_destroy(&batch);
+				return 1;
+			}
+			spec_path = argv[i + 1];
+			i++;
+		}
+		// More inputs: one path per line of a file, or everything in a 
+		// directory tree
+		else if (strcmp(argv[i], "--manifest") == 0 || strcmp(argv[i], "--directory") == 0) {
+			if (i + 1 >= argc) {
+				print_usage();
+				batch_paths_destroy(&batch);
+				return 1;
+			}
+
+			int status = (argv[i][2] == 'm') ? batch_paths_add_manifest(&batch, argv[i + 1]) : batch_paths_add_directory(&batch, argv[i + 1]);
+			if (status == EXIT_FAILURE) {
+				fprintf(stderr, "Failed to list the inputs in \"%s\".\n", argv[i + 1]);
+				batch_paths_destroy(&batch);
+				return 1;
+			}
+			batch_mode = true;
+			i++;
+		}
+		else {
+			if (path != NULL)
+				batch_mode = true;
+			path = argv[i];
+			if (batch_paths_add(&batch, path) == EXIT_FAILURE) {
+				batch_paths_destroy(&batch);
+				return 1;
+			}
+		}
+	}
+
+	if (path == NULL && ! batch_mode) {
 		print_usage();
+		batch_paths_destroy(&batch);
 		return 1;
 	}
 
-	FILE *fh = fopen(argv[1], "r");
-	if (fh == NULL) {
-		fprintf(stderr, "Failed to open \"%s\"\n", argv[1]);
+	// Cached tokens and the parallel tokenizer only follow the built-in 
+	// rules
+	if (spec_path != NULL && ! batch_mode && (parallel || cache_directory != NULL)) {
+		fprintf(stderr, "--spec does not work with --threads or --cache-dir on a single input.\n");
+		batch_paths_destroy(&batch);
 		return 1;
 	}
 
+	struct TokenSpec *spec = NULL;
+	if (spec_path != NULL) {
+		spec = spec_load(spec_path);
+		if (spec == NULL) {
+			fprintf(stderr, "Failed to load the spec \"%s\".\n", spec_path);
+			batch_paths_destroy(&batch);
+			return 1;
+		}
+	}
 
-	// Create a buffer to hold file contents
-	size_t data_length = 0;
-	size_t data_capacity = 512;
-	char *data = malloc(data_capacity);
-	if (data == NULL) {
-		fprintf(stderr, "Failed to allocate initial %zu bytes for the text buffer that contains the file's contents.\n", data_capacity);
-		fclose(fh);
+	// Several inputs are tokenized on a thread pool (--threads sets its
+	// size) and written out one after the other, in the order given
+	if (batch_mode) {
+		if (cache_directory != NULL) {
+			fprintf(stderr, "--cache-dir only works with a single input.\n");
+			if (spec != NULL)
+				spec_destroy(spec);
+			batch_paths_destroy(&batch);
+			return 1;
+		}
+
+		struct TokenizerStats stats;
+		if (collect_stats) {
+			stats_reset(&stats);
+			stats_attach(&stats);
+		}
+
+		struct Writer *writer = writer_create(STDOUT_FILENO, format);
+		int status = EXIT_FAILURE;
+		if (writer != NULL) {
+			status = batch_tokenize(&batch, threads, spec, writer);
+			if (writer_destroy(writer) == EXIT_FAILURE)
+				status = EXIT_FAILURE;
+		}
+
+		if (collect_stats)
+			stats_print(stderr, &stats);
+
+		if (spec != NULL)
+			spec_destroy(spec);
+		batch_paths_destroy(&batch);
+		return (status == EXIT_SUCCESS) ? 0 : 1;
+	}
+	batch_paths_destroy(&batch);
+
+	struct TokenizerStats stats;
+	if (collect_stats) {
+		stats_reset(&stats);
+		stats_attach(&stats);
+	}
+
+	// All token memory lives in one arena, released in one go at the end
+	struct Arena *arena = arena_create(0);
+	if (arena == NULL) {
+		fprintf(stderr, "Failed to create the tokenizer arena.\n");
+		if (spec != NULL)
+			spec_destroy(spec);
 		return 1;
 	}
 
+	// Tokens are formatted into large blocks and written straight to the
+	// standard output, bypassing stdio
+	struct Writer *writer = writer_create(STDOUT_FILENO, format);
+	if (writer == NULL) {
+		fprintf(stderr, "Failed to create the output writer.\n");
+		if (spec != NULL)
+			spec_destroy(spec);
+		arena_destroy(arena);
+		return 1;
+	}
 
-	// Read file
-	printf("Reading file...\n");
-	char c = 0;
-	void *realloc_ptr = NULL;
-	while (c != EOF) {
-		c = fgetc(fh);
-		data[data_length] = c;
-		data_length++;
-		if (data_length >= data_capacity) {
-			data_capacity *= 2;
-			realloc_ptr = realloc(data, data_capacity);
-			if (realloc_ptr == NULL) {
-				fprintf(stderr, "Failed to reallocate memory for the text buffer containing the file's contents. Reallocation target was %zu bytes.\n", data_capacity);
-				free(data);
-				fclose(fh);
-				return 1;
+	// Tokenize. Files are mapped and tokenized in place; standard input
+	// ("-") cannot be mapped, so it is read in large blocks first.
+	struct Source source;
+	size_t tokens_length = 0;
+	size_t tokens_capacity = 0;
+	struct Token *tokens = NULL;
+	struct SymbolTable *symbols = NULL;
+	LOG_INFO("Attempting to tokenize...\n");
+	if (strcmp(path, "-") == 0 || parallel || cache_directory != NULL || spec != NULL) {
+		struct StatsTimer timer;
+		stats_timer_start(&timer);
+		int status = (strcmp(path, "-") == 0) ? source_open_fd(STDIN_FILENO, &source) : source_open(path, &source);
+		stats_timer_stop(&timer, STATS_PHASE_READ);
+		if (status == EXIT_FAILURE) {
+			fprintf(stderr, "Failed to read \"%s\".\n", path);
+			if (spec != NULL)
+				spec_destroy(spec);
+			writer_destroy(writer);
+			arena_destroy(arena);
+			return 1;
+		}
+
+		// Case 1: The input was tokenized before. The cache file is keyed
+		//         by the input's hash, so an unchanged input skips the 
+		//         tokenizer altogether.
+		char cache_path[4096];
+		uint64_t input_hash = 0;
+		if (cache_directory != NULL) {
+			input_hash = cache_hash(source.data, source.length);
+			snprintf(cache_path, sizeof(cache_path), "%s/%016llx.tok", cache_directory, (unsigned long long) input_hash);
+
+			struct TokenCache cache;
+			if (cache_open(cache_path, input_hash, source.length, &cache) == EXIT_SUCCESS) {
+				LOG_INFO("Loaded %zu tokens from \"%s\".\n", cache.tokens_count, cache_path);
+				struct Token token;
+				struct LineIndex lines;
+				line_index_init(&lines, source.data, source.length);
+
+				// Tokens are checked as they are read. Those before a bad
+				// one are already written, so a damaged file fails the run
+				// and is removed, and the next run tokenizes the input.
+				bool corrupt = false;
+				for (size_t i = 0; i < cache.tokens_count; i++) {
+					if (cache_token(&cache, i, &token) == EXIT_FAILURE) {
+						fprintf(stderr, "Cache file \"%s\" is corrupt, removing it.\n", cache_path);
+						remove(cache_path);
+						corrupt = true;
+						break;
+					}
+					writer_token(writer, &token, source.data);
+					if (token.metadata.numeric_overflow)
+						line_index_report_overflow(&lines, stderr, path, &token);
+				}
+				line_index_destroy(&lines);
+
+				int status = writer_destroy(writer);
+				if (corrupt)
+					status = EXIT_FAILURE;
+				if (collect_stats)
+					stats_print(stderr, &stats);
+
+				cache_close(&cache);
+				arena_destroy(arena);
+				source_close(&source);
+				return (status == EXIT_SUCCESS) ? 0 : 1;
 			}
-			data = (char*) realloc_ptr;	
 		}
-	} 
-	data[data_length] = '\0';	
-	fclose(fh);
-	printf("Done reading file.\n");
 
+		// Case 2: Tokenize it. The parallel tokenizer merges per-thread 
+		//         results on the heap, and cached tokens are interned.
+		if (spec != NULL)
+			tokens = tokenize_with_spec(spec, arena, source.data, source.length, &tokens_length, NULL);
+		else if (parallel)
+			tokens = tokenize_parallel(source.data, source.length, threads, &tokens_length, &tokens_capacity);
+		else if (cache_directory != NULL) {
+			symbols = symbols_create();
+			if (symbols != NULL)
+				tokens = tokenize_interned(symbols, source.data, source.length, &tokens_length, &tokens_capacity);
+		}
+		else
+			tokens = tokenize_arena(arena, source.data, source.length, &tokens_length);
+
+		// Failing to write the cache only costs the next run some time
+		if (tokens != NULL && cache_directory != NULL)
+			cache_write(cache_path, input_hash, source.length, tokens, tokens_length, symbols);
+
+		if (tokens == NULL)
+			source_close(&source);
+	}
+	else
+		tokens = tokenize_file(path, arena, &source, &tokens_length);
 
-	// Tokenize
-	size_t tokens_length = 0;
-	size_t tokens_capacity = 128;
-	printf("Attempting to tokenize...\n");
-	struct Token *tokens = tokenize(data, data_length, &tokens_length, &tokens_capacity);
 	if (tokens == NULL) {
-		fprintf(stderr, "Failed to tokenize.\n");
-		free(data);
+		fprintf(stderr, "Failed to tokenize \"%s\".\n", path);
+		if (symbols != NULL)
+			symbols_destroy(symbols);
+		if (spec != NULL)
+			spec_destroy(spec);
+		writer_destroy(writer);
+		arena_destroy(arena);
 		return 1;
 	}
+	char *data = source.data;
 	
-	for (size_t i = 0; i < tokens_length; i++) 
-		lex( &(tokens[i]) );
+	// Lines are only indexed once a literal has to be reported
+	struct LineIndex lines;
+	line_index_init(&lines, data, source.length);
+	for (size_t i = 0; i < tokens_length; i++) {
+		writer_token(writer, &(tokens[i]), data);
+		if (tokens[i].metadata.numeric_overflow)
+			line_index_report_overflow(&lines, stderr, path, &(tokens[i]));
+	}
+	line_index_destroy(&lines);
 
-	for (size_t i = 0; i < tokens_length; i++)
-		token_print(&(tokens[i]));
+	int status = writer_destroy(writer);
+	if (collect_stats)
+		stats_print(stderr, &stats);
 
-	tokens_destroy(tokens, tokens_length);
-	free(data);
-	return 0;
+	if (parallel || cache_directory != NULL)
+		tokens_destroy(tokens, tokens_length);
+	if (symbols != NULL)
+		symbols_destroy(symbols);
+	if (spec != NULL)
+		spec_destroy(spec);
+	arena_destroy(arena);
+	source_close(&source);
+	return (status == EXIT_SUCCESS) ? 0 : 1;
 }
@@ -2,20 +2,165 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <pthread.h>
+#include <unistd.h>
 #include "tokenizer.h"
+#include "arena.h"
+#include "log.h"
+#include "keywords.h"
+#include "classify.h"
+#include "stats.h"
+#include "symbols.h"
+#include "spec.h"
 #define DEFAULT_TOKENS_AMOUNT 128
+#define ESTIMATE_SAMPLES 16
+#define ESTIMATE_SAMPLE_SIZE 4096
+#define PARALLEL_MIN_SLICE_SIZE (256 * 1024)
+
+// What the scanner does with a byte
+enum ScanAction {
+	SCAN_ACTION_RUN,         // Add the run of ordinary bytes starting here
+	SCAN_ACTION_EXTEND,      // Add just this byte
+	SCAN_ACTION_SKIP,        // Skip the run of whitespace starting here
+	SCAN_ACTION_CLOSE,       // End the current token, dropping this byte
+	SCAN_ACTION_SPECIAL,     // This byte is a token of its own
+	SCAN_ACTION_OPEN_STRING, // Start a string literal after this byte
+	SCAN_ACTION_STOP         // Ignore the rest of the data
+};
+
+enum CharClass {
+	CHAR_CLASS_ORDINARY,
+	CHAR_CLASS_WHITESPACE,
+	CHAR_CLASS_BACKSLASH,
+	CHAR_CLASS_QUOTE,
+	CHAR_CLASS_SPECIAL,
+	CHAR_CLASS_EOF,
+	CHAR_CLASS_COUNT
+};
+
+struct ScanTransition {
+	unsigned char action;
+	unsigned char next;
+};
+
+// Class of every byte. Adding a special character takes an entry here and
+// one in special_token_types.
+static const unsigned char char_classes[256] = {
+	['\t'] = CHAR_CLASS_WHITESPACE,
+	['\n'] = CHAR_CLASS_WHITESPACE,
+	[' ']  = CHAR_CLASS_WHITESPACE,
+	['\\'] = CHAR_CLASS_BACKSLASH,
+	['"']  = CHAR_CLASS_QUOTE,
+	['(']  = CHAR_CLASS_SPECIAL,
+	[')']  = CHAR_CLASS_SPECIAL,
+	['[']  = CHAR_CLASS_SPECIAL,
+	[']']  = CHAR_CLASS_SPECIAL,
+	['{']  = CHAR_CLASS_SPECIAL,
+	['}']  = CHAR_CLASS_SPECIAL,
+	['+']  = CHAR_CLASS_SPECIAL,
+	['-']  = CHAR_CLASS_SPECIAL,
+	['*']  = CHAR_CLASS_SPECIAL,
+	['/']  = CHAR_CLASS_SPECIAL,
+	[(unsigned char) EOF] = CHAR_CLASS_EOF
+};
+
+static const enum TokenType special_token_types[256] = {
+	['('] = TOKEN_TYPE_LEFT_PARENTHESIS,
+	[')'] = TOKEN_TYPE_RIGHT_PARENTHESIS,
+	['['] = TOKEN_TYPE_LEFT_BRACKET,
+	[']'] = TOKEN_TYPE_RIGHT_BRACKET,
+	['{'] = TOKEN_TYPE_LEFT_BRACE,
+	['}'] = TOKEN_TYPE_RIGHT_BRACE,
+	['+'] = TOKEN_TYPE_PLUS,
+	['-'] = TOKEN_TYPE_MINUS,
+	['*'] = TOKEN_TYPE_ASTERISK,
+	['/'] = TOKEN_TYPE_SLASH
+};
+
+// The scanner itself. Some notes on the rules it encodes:
+// (1) Whitespace always cancels a backslash. Escaping whitespace is not a thing.
+// (2) Inside a string literal whitespace and special characters are
+//     ordinary, and only a quote that is not escaped closes the literal.
+// (3) A backslash is part of the token, so whitespace after one ends that
+//     token rather than being skipped.
+// (4) A special character ends the token being read but does not cancel a
+//     backslash before it.
+#define SCAN(action, next) { SCAN_ACTION_##action, SCAN_STATE_##next }
+static const struct ScanTransition scan_transitions[SCAN_STATE_COUNT][CHAR_CLASS_COUNT] = {
+	[SCAN_STATE_START] = {
+		[CHAR_CLASS_ORDINARY]   = SCAN(RUN, WORD),
+		[CHAR_CLASS_WHITESPACE] = SCAN(SKIP, START),
+		[CHAR_CLASS_BACKSLASH]  = SCAN(EXTEND, WORD_ESCAPED),
+		[CHAR_CLASS_QUOTE]      = SCAN(OPEN_STRING, STRING),
+		[CHAR_CLASS_SPECIAL]    = SCAN(SPECIAL, START),
+		[CHAR_CLASS_EOF]        = SCAN(STOP, START)
+	},
+	[SCAN_STATE_START_ESCAPED] = {
+		[CHAR_CLASS_ORDINARY]   = SCAN(RUN, WORD),
+		[CHAR_CLASS_WHITESPACE] = SCAN(SKIP, START),
+		[CHAR_CLASS_BACKSLASH]  = SCAN(EXTEND, WORD),
+		[CHAR_CLASS_QUOTE]      = SCAN(OPEN_STRING, STRING_ESCAPED),
+		[CHAR_CLASS_SPECIAL]    = SCAN(SPECIAL, START_ESCAPED),
+		[CHAR_CLASS_EOF]        = SCAN(STOP, START_ESCAPED)
+	},
+	[SCAN_STATE_WORD] = {
+		[CHAR_CLASS_ORDINARY]   = SCAN(RUN, WORD),
+		[CHAR_CLASS_WHITESPACE] = SCAN(CLOSE, START),
+		[CHAR_CLASS_BACKSLASH]  = SCAN(EXTEND, WORD_ESCAPED),
+		[CHAR_CLASS_QUOTE]      = SCAN(OPEN_STRING, STRING),
+		[CHAR_CLASS_SPECIAL]    = SCAN(SPECIAL, START),
+		[CHAR_CLASS_EOF]        = SCAN(STOP, WORD)
+	},
+	[SCAN_STATE_WORD_ESCAPED] = {
+		[CHAR_CLASS_ORDINARY]   = SCAN(RUN, WORD),
+		[CHAR_CLASS_WHITESPACE] = SCAN(CLOSE, START),
+		[CHAR_CLASS_BACKSLASH]  = SCAN(EXTEND, WORD),
+		[CHAR_CLASS_QUOTE]      = SCAN(OPEN_STRING, STRING_ESCAPED),
+		[CHAR_CLASS_SPECIAL]    = SCAN(SPECIAL, START_ESCAPED),
+		[CHAR_CLASS_EOF]        = SCAN(STOP, WORD_ESCAPED)
+	},
+	[SCAN_STATE_STRING] = {
+		[CHAR_CLASS_ORDINARY]   = SCAN(RUN, STRING),
+		[CHAR_CLASS_WHITESPACE] = SCAN(RUN, STRING),
+		[CHAR_CLASS_BACKSLASH]  = SCAN(EXTEND, STRING_ESCAPED),
+		[CHAR_CLASS_QUOTE]      = SCAN(CLOSE, START),
+		[CHAR_CLASS_SPECIAL]    = SCAN(RUN, STRING),
+		[CHAR_CLASS_EOF]        = SCAN(STOP, STRING)
+	},
+	[SCAN_STATE_STRING_ESCAPED] = {
+		[CHAR_CLASS_ORDINARY]   = SCAN(RUN, STRING),
+		[CHAR_CLASS_WHITESPACE] = SCAN(RUN, STRING),
+		[CHAR_CLASS_BACKSLASH]  = SCAN(EXTEND, STRING),
+		[CHAR_CLASS_QUOTE]      = SCAN(EXTEND, STRING),
+		[CHAR_CLASS_SPECIAL]    = SCAN(EXTEND, STRING_ESCAPED),
+		[CHAR_CLASS_EOF]        = SCAN(STOP, STRING_ESCAPED)
+	}
+};
+#undef SCAN
+
+static struct CharClasses default_classes;
+static pthread_once_t default_classes_once = PTHREAD_ONCE_INIT;
+
+static void default_classes_build(void) {
+	unsigned char special_char_lookup_table[256];
+	for (int i = 0; i < 256; i++)
+		special_char_lookup_table[i] = char_classes[i] == CHAR_CLASS_SPECIAL;
+
+	classify_init(&default_classes, special_char_lookup_table);
+}
+
+static inline bool scan_state_in_quote(enum ScanState state) {
+	return state == SCAN_STATE_STRING || state == SCAN_STATE_STRING_ESCAPED;
+}
 
 void tokens_destroy(struct Token *tokens, size_t length) {
 	if (tokens == NULL) {
-		fprintf(stderr, "[%s] ERROR: Provided parameter `struct Token *tokens` is a NULL pointer.\n", __func__);
-		return;
-	}
-
-	if (length == 0) {
-		fprintf(stderr, "[%s] ERROR: Provided parameter `size_t length` is 0.\n", __func__);
+		LOG_ERROR("Provided parameter `struct Token *tokens` is a NULL pointer.\n");
 		return;
 	}
 
+	// A length of 0 is fine (e.g. input that was all whitespace): there
+	// are no values to free, but the buffer itself still has to go.
 	struct Token *current;
 	for (size_t i = 0; i < length; i++) {
 		current = &(tokens[i]);
@@ -31,12 +176,12 @@ void tokens_destroy(struct Token *tokens, size_t length) {
 
 int tokens_init(struct Token *tokens, size_t length) {
 	if (tokens == NULL) {
-		fprintf(stderr, "[%s] ERROR: Provided parameter `struct Tokens *tokens` is a NULL pointer.\n", __func__);
+		LOG_ERROR("Provided parameter `struct Tokens *tokens` is a NULL pointer.\n");
 		return EXIT_FAILURE;
 	}
 
 	if (length == 0) {
-		fprintf(stderr, "[%s] ERROR: Provided parameter `size_t length` is 0.\n", __func__);
+		LOG_ERROR("Provided parameter `size_t length` is 0.\n");
 		return EXIT_FAILURE;
 	}
 	
@@ -46,228 +191,300 @@ int tokens_init(struct Token *tokens, size_t length) {
 		current = &(tokens[i]);
 		metadata = &(current->metadata);
 		
-		// Give the token 32 characters of space for now.
+		// Tokens start out as empty spans. No value buffer is allocated
+		// until someone asks for an owned copy.
 		current->type = TOKEN_TYPE_NONE;
+		current->value = NULL;
+		current->offset = 0;
 		current->value_length   = 0;
-		current->value_capacity = 32;
-		current->value = malloc(current->value_capacity);
-		if (current->value == NULL) {
-			tokens_destroy(tokens, length);
-			return EXIT_FAILURE;
-		}
+		current->value_capacity = 0;
+		current->symbol = SYMBOL_NONE;
+		current->number.integer = 0;
 
 		metadata->numeric_digits = 0;
 		metadata->dots = 0;
+		metadata->numeric_overflow = 0;
 	}
 
 	return EXIT_SUCCESS;
 }
 
-void token_print(struct Token *token) {
-	if (token == NULL) {
-		fprintf(stderr, "[%s] ERROR: Provided value for argument `struct Token *token` is a NULL pointer.\n", __func__);
-		return;
-	}
-
+const char* token_text(const struct Token *token, const char *data) {
 	if (token->value != NULL)
-		printf("Value: \"%s\"\n", token->value);
-	else 
-		printf("Value: <NULL (maybe something went wrong?)>\n");
-	
-	printf("Type: ");
-	switch (token->type) {
-		case TOKEN_TYPE_NONE:
-			printf("TOKEN_TYPE_NONE\n");
-			break;
-
-		case TOKEN_TYPE_VAR_ID: 
-			printf("TOKEN_TYPE_VAR_ID\n");
-			break; 
-
-		case TOKEN_TYPE_FUNCTION_ID: 
-			printf("TOKEN_TYPE_FUNCTION_ID\n");	
-			break;
-
-		case TOKEN_TYPE_STRUCT_ID: 
-			printf("TOKEN_TYPE_STRUCT_ID\n");
-			break;
-
-		case TOKEN_TYPE_STRING_LITERAL:
-			printf("TOKEN_TYPE_STRING_LITERAL\n");	
-			break;
-
-		case TOKEN_TYPE_INTEGER_LITERAL: 
-			printf("TOKEN_TYPE_INTEGER_LITERAL\n");	
-			break;
-
-		case TOKEN_TYPE_FLOAT_LITERAL:
-			printf("TOKEN_TYPE_FLOAT_LITERAL\n");	
-			break;
+		return token->value;
 
-		case TOKEN_TYPE_KEYWORD:
-			printf("TOKEN_TYPE_KEYWORD\n");	
-			break;
-
-		case TOKEN_TYPE_LEFT_PARENTHESIS:
-			printf("TOKEN_TYPE_LEFT_PARENTHESIS\n");	
-			break;
-
-		case TOKEN_TYPE_RIGHT_PARENTHESIS:
-			printf("TOKEN_TYPE_RIGHT_PARENTHESIS\n");	
-			break;
-
-		case TOKEN_TYPE_LEFT_BRACKET: 
-			printf("TOKEN_TYPE_LEFT_BRACKET\n");	
-			break;
-
-		case TOKEN_TYPE_RIGHT_BRACKET: 
-			printf("TOKEN_TYPE_RIGHT_BRACKET\n"); 	
-			break; 
-
-		case TOKEN_TYPE_ASSIGNMENT:
-			printf("TOKEN_TYPE_ASSIGNMENT\n");	
-			break;
-
-		case TOKEN_TYPE_EQUALS:
-			printf("TOKEN_TYPE_EQUALS\n");
-			break;
-
-		case TOKEN_TYPE_PLUS:
-			printf("TOKEN_TYPE_PLUS\n");
-			break;
-
-		case TOKEN_TYPE_MINUS:
-			printf("TOKEN_TYPE_MINUS\n");
-			break;
+	return data + token->offset;
+}
 
-		case TOKEN_TYPE_ASTERISK:
-			printf("TOKEN_TYPE_ASTERISK\n");
-			break;
+static const char *token_type_names[TOKEN_TYPE_COUNT] = {
+	[TOKEN_TYPE_NONE]              = "TOKEN_TYPE_NONE",
+	[TOKEN_TYPE_VAR_ID]            = "TOKEN_TYPE_VAR_ID",
+	[TOKEN_TYPE_FUNCTION_ID]       = "TOKEN_TYPE_FUNCTION_ID",
+	[TOKEN_TYPE_STRUCT_ID]         = "TOKEN_TYPE_STRUCT_ID",
+	[TOKEN_TYPE_STRING_LITERAL]    = "TOKEN_TYPE_STRING_LITERAL",
+	[TOKEN_TYPE_INTEGER_LITERAL]   = "TOKEN_TYPE_INTEGER_LITERAL",
+	[TOKEN_TYPE_FLOAT_LITERAL]     = "TOKEN_TYPE_FLOAT_LITERAL",
+	[TOKEN_TYPE_KEYWORD]           = "TOKEN_TYPE_KEYWORD",
+	[TOKEN_TYPE_LEFT_PARENTHESIS]  = "TOKEN_TYPE_LEFT_PARENTHESIS",
+	[TOKEN_TYPE_RIGHT_PARENTHESIS] = "TOKEN_TYPE_RIGHT_PARENTHESIS",
+	[TOKEN_TYPE_LEFT_BRACKET]      = "TOKEN_TYPE_LEFT_BRACKET",
+	[TOKEN_TYPE_RIGHT_BRACKET]     = "TOKEN_TYPE_RIGHT_BRACKET",
+	[TOKEN_TYPE_ASSIGNMENT]        = "TOKEN_TYPE_ASSIGNMENT",
+	[TOKEN_TYPE_EQUALS]            = "TOKEN_TYPE_EQUALS",
+	[TOKEN_TYPE_PLUS]              = "TOKEN_TYPE_PLUS",
+	[TOKEN_TYPE_MINUS]             = "TOKEN_TYPE_MINUS",
+	[TOKEN_TYPE_ASTERISK]          = "TOKEN_TYPE_ASTERISK",
+	[TOKEN_TYPE_SLASH]             = "TOKEN_TYPE_SLASH",
+	[TOKEN_TYPE_DOT]               = "TOKEN_TYPE_DOT",
+	[TOKEN_TYPE_LEFT_BRACE]        = "TOKEN_TYPE_LEFT_BRACE",
+	[TOKEN_TYPE_RIGHT_BRACE]       = "TOKEN_TYPE_RIGHT_BRACE",
+	[TOKEN_TYPE_IDENTIFIER]        = "TOKEN_TYPE_IDENTIFIER",
+	[TOKEN_TYPE_OPERATOR]          = "TOKEN_TYPE_OPERATOR"
+};
+
+const char* token_type_name(enum TokenType type) {
+	if ((unsigned int) type >= TOKEN_TYPE_COUNT)
+		return "<UNKNOWN TYPE>";
+
+	return token_type_names[type];
+}
 
-		case TOKEN_TYPE_SLASH: 
-			printf("TOKEN_TYPE_SLASH\n");
-			break;
-			
-		case TOKEN_TYPE_DOT: 
-			printf("TOKEN_TYPE_DOT\n");
-			break;
+void token_fprint(FILE *stream, struct Token *token, const char *data) {
+	if (stream == NULL) {
+		LOG_ERROR("Provided value for argument `FILE *stream` is a NULL pointer.\n");
+		return;
+	}
 
-		case TOKEN_TYPE_LEFT_BRACE: 
-			printf("TOKEN_TYPE_LEFT_BRACE\n");
-			break;
+	if (token == NULL) {
+		LOG_ERROR("Provided value for argument `struct Token *token` is a NULL pointer.\n");
+		return;
+	}
 
-		case TOKEN_TYPE_RIGHT_BRACE:
-			printf("TOKEN_TYPE_RIGHT_BRACE\n");
-			break;
+	if (token->value != NULL || data != NULL)
+		fprintf(stream, "Value: \"%.*s\"\n", (int) token->value_length, token_text(token, data));
+	else 
+		fprintf(stream, "Value: <NULL (maybe something went wrong?)>\n");
+	
+	fprintf(stream, "Type: %s\n\n", token_type_name(token->type));
+}
 
-		default:
-			printf("<UNKNOWN TYPE>\n");	
-	}
-	printf("\n");
+void token_print(struct Token *token, const char *data) {
+	token_fprint(stdout, token, data);
 }
 
 int token_add_character(struct Token *token, char c) {
 	if (token == NULL) {
-		fprintf(stderr, "[%s] ERROR: Provided argument `struct Token *token` is a NULL pointer.\n", __func__);
+		LOG_ERROR("Provided argument `struct Token *token` is a NULL pointer.\n");
 		return EXIT_FAILURE;
 	} 
 	
-	// Allocate more space for the token's value buffer if necessary
+	// Allocate more space for the token's value buffer if necessary. The
+	// extra byte keeps room for a NUL terminator.
 	void *realloc_ptr = NULL;
-	if (token->value_length >= token->value_capacity) {
-		token->value_capacity *= 2;
-		printf("[%s] INFO: Token length (%u) has reached or exceeded capacity. Capacity has been doubled to %u.\n", __func__, token->value_length, token->value_capacity);
+	if (token->value == NULL || token->value_length + 1 >= token->value_capacity) {
+		token->value_capacity = (token->value_capacity == 0) ? 32 : token->value_capacity * 2;
+		LOG_DEBUG("Token length (%u) has reached or exceeded capacity. Capacity has been doubled to %u.\n", token->value_length, token->value_capacity);
 
 		realloc_ptr = realloc(token->value, token->value_capacity);
 		if (realloc_ptr == NULL) {
-			fprintf(stderr, "[%s] ERROR: Failed to reallocate the `char *value` buffer of the provided token.\n", __func__);
+			LOG_ERROR("Failed to reallocate the `char *value` buffer of the provided token.\n");
 			return EXIT_FAILURE;
 		}
 
 		token->value = (char*) realloc_ptr;	
+		STATS_ADD(value_growths, 1);
+		STATS_ADD(bytes_allocated, token->value_capacity);
 	}
 	
 	// Add the character
 	token->value[token->value_length] = c;
 	token->value_length++;
+	token->value[token->value_length] = '\0';
 	
 	return EXIT_SUCCESS;
 }
 
-// Updates the metadata of a token (e.g. sets the proper token type attribute)
-int lex(struct Token *token) {
+// Shared by token_materialize() and token_materialize_arena(). The copy
+// comes from the arena when one is given, otherwise from the heap.
+static char* token_materialize_internal(struct Token *token, const char *data, struct Arena *arena) {
 	if (token == NULL) {
-		fprintf(stderr, "[%s] ERROR: Provided argument `struct Token *token` is a NULL pointer.\n", __func__);
-		return EXIT_FAILURE;
+		LOG_ERROR("Provided argument `struct Token *token` is a NULL pointer.\n");
+		return NULL;
 	}
-	
+
+	// Already owned, nothing to do
+	if (token->value != NULL)
+		return token->value;
+
+	if (data == NULL) {
+		LOG_ERROR("Provided argument `const char *data` is a NULL pointer.\n");
+		return NULL;
+	}
+
+	const char *source = data + token->offset;
+	char *copy = (arena != NULL) ? arena_alloc(arena, token->value_length + 1) : malloc(token->value_length + 1);
+	if (copy == NULL) {
+		LOG_ERROR("Failed to allocate %u bytes for the owned copy of the token.\n", token->value_length + 1);
+		return NULL;
+	}
+	STATS_ADD(bytes_allocated, token->value_length + 1);
+
+	// Only string literals carry escape sequences that need decoding. A 
+	// backslash escapes the character after it, so "\\" becomes "\" and "\"" 
+	// becomes '"'.
+	unsigned int copy_length = 0;
+	if (token->type == TOKEN_TYPE_STRING_LITERAL) {
+		for (unsigned int i = 0; i < token->value_length; i++) {
+			if (source[i] == '\\' && i + 1 < token->value_length && (source[i + 1] == '"' || source[i + 1] == '\\'))
+				i++;
+
+			copy[copy_length] = source[i];
+			copy_length++;
+		}
+	}
+	else {
+		memcpy(copy, source, token->value_length);
+		copy_length = token->value_length;
+	}
+	copy[copy_length] = '\0';
+
+	token->value = copy;
+	token->value_length = copy_length;
+	token->value_capacity = token->value_length + 1;
+	return copy;
+}
+
+char* token_materialize(struct Token *token, const char *data) {
+	return token_materialize_internal(token, data, NULL);
+}
+
+char* token_materialize_arena(struct Token *token, const char *data, struct Arena *arena) {
+	if (arena == NULL) {
+		LOG_ERROR("Provided argument `struct Arena *arena` is a NULL pointer.\n");
+		return NULL;
+	}
+
+	return token_materialize_internal(token, data, arena);
+}
+
+// Extends the token's span by the character at `index`. Characters of a
+// token are always contiguous in the data, so only the first one has to 
+// record where the span begins.
+static inline void token_span_extend(struct Token *token, size_t index) {
+	if (token->value_length == 0)
+		token->offset = index;
+
+	token->value_length++;
+}
+
+// Classifies a token whose bytes are `text`. Shared by the lex functions,
+// which only differ in how they find the bytes and the keyword set.
+static int lex_text(struct Token *token, const char *text, const struct KeywordTable *keywords) {
 	if (token->type != TOKEN_TYPE_NONE) {
-		fprintf(stderr, "[%s] INFO: Received a token which has already had its type inferred (condition `token->type != TOKEN_TYPE_NONE` was true).\n", __func__);
+		LOG_DEBUG("Received a token which has already had its type inferred (condition `token->type != TOKEN_TYPE_NONE` was true).\n");
 		return EXIT_FAILURE;
 	}
 
+	// Empty tokens have nothing to classify
+	if (token->value_length == 0)
+		return EXIT_FAILURE;
+
 	struct TokenMetadata *metadata = &(token->metadata);
+	// Numbers are converted right away, while their bytes are still in 
+	// the cache, so nobody has to parse them again
 	if (metadata->numeric_digits == token->value_length) {
 		token->type = TOKEN_TYPE_INTEGER_LITERAL;
+		metadata->numeric_overflow = ! number_parse_integer(text, token->value_length, &(token->number.integer));
 		return EXIT_SUCCESS;
 	}
 
 	if (metadata->dots == 1 && metadata->numeric_digits == (token->value_length) - 1) {
 		token->type = TOKEN_TYPE_FLOAT_LITERAL;
+		metadata->numeric_overflow = ! number_parse_float(text, token->value_length, &(token->number.real));
 		return EXIT_SUCCESS;
 	}
 	
-	// Replace this with a hashset later. It's 2:30AM and I'm a little tired
-	if (strcmp(token->value, "int") == 0) {
+	// Keywords are looked up in a perfect hash table, so this costs the
+	// same no matter how many keywords the language has.
+	if (keywords_contains(keywords, text, token->value_length)) {
 		token->type = TOKEN_TYPE_KEYWORD;
 		return EXIT_SUCCESS;
 	}
-	else if (strcmp(token->value, "float") == 0) {
-		token->type = TOKEN_TYPE_KEYWORD;
-		return EXIT_SUCCESS;
-	}
-	else if (strcmp(token->value, "field") == 0) {
-		token->type = TOKEN_TYPE_KEYWORD;
-		return EXIT_SUCCESS;
-	}
-	else if (strcmp(token->value, "constrain") == 0) {
-		token->type = TOKEN_TYPE_KEYWORD;
+
+	// Case 1: the token is a name of some sort. Whether it names a
+	// variable, function or struct is for the parser to decide.
+	unsigned char first = (unsigned char) text[0];
+	if (first == '_' || (first >= 'a' && first <= 'z') || (first >= 'A' && first <= 'Z')) {
+		token->type = TOKEN_TYPE_IDENTIFIER;
 		return EXIT_SUCCESS;
 	}
-	else if (strcmp(token->value, "of") == 0) {
-		token->type = TOKEN_TYPE_KEYWORD;
-		return EXIT_SUCCESS;
+
+	// Case 2: the token is something the tokenizer doesn't know (yet)
+	return EXIT_FAILURE;
+}
+
+// Updates the metadata of a token (e.g. sets the proper token type attribute).
+// The tokenizer already does this as it closes each token, so this is only
+// needed for tokens built some other way.
+int lex_keywords(struct Token *token, const char *data, const struct KeywordTable *keywords) {
+	if (token == NULL) {
+		LOG_ERROR("Provided argument `struct Token *token` is a NULL pointer.\n");
+		return EXIT_FAILURE;
 	}
-	else if (strcmp(token->value, "is") == 0) {
-		token->type = TOKEN_TYPE_KEYWORD;
-		return EXIT_SUCCESS;
+
+	if (keywords == NULL) {
+		LOG_ERROR("Provided argument `const struct KeywordTable *keywords` is a NULL pointer.\n");
+		return EXIT_FAILURE;
 	}
-	else if (strcmp(token->value, "size") == 0) {
-		token->type = TOKEN_TYPE_KEYWORD;
-		return EXIT_SUCCESS;
-	} 
-	else if (strcmp(token->value, "on") == 0) {
-		token->type = TOKEN_TYPE_KEYWORD;
-		return EXIT_SUCCESS;
+
+	struct StatsTimer timer;
+	stats_timer_start(&timer);
+	int status = lex_text(token, token_text(token, data), keywords);
+	stats_timer_stop(&timer, STATS_PHASE_LEX);
+	return status;
+}
+
+int lex(struct Token *token, const char *data) {
+	return lex_keywords(token, data, keywords_default());
+}
+
+int tokenizer_lex(const struct Tokenizer *tokenizer, struct Token *token) {
+	if (tokenizer == NULL) {
+		LOG_ERROR("Provided argument `const struct Tokenizer *tokenizer` is a NULL pointer.\n");
+		return EXIT_FAILURE;
 	}
-	else
+
+	if (token == NULL) {
+		LOG_ERROR("Provided argument `struct Token *token` is a NULL pointer.\n");
 		return EXIT_FAILURE;
+	}
+
+	// Streamed tokens are resolved against the current chunk
+	return lex_text(token, tokenizer_token_text(tokenizer, token), tokenizer->keywords);
 }
 
-// Returns a pointer to the next token
-struct Token* tokens_advance(struct Token **tokens, size_t *length, size_t *capacity) {
+// Frees a tokens buffer on an error path. Arena-backed buffers are left
+// alone, since the arena owns them and releases them all at once.
+static void tokens_release(struct Arena *arena, struct Token *tokens, size_t length) {
+	if (arena == NULL)
+		tokens_destroy(tokens, length);
+}
+
+// Returns a pointer to the next token. The buffer grows in the arena when
+// one is given, otherwise on the heap.
+static struct Token* tokens_advance_internal(struct Arena *arena, struct Token **tokens, size_t *length, size_t *capacity) {
 	if (tokens == NULL) {
-		fprintf(stderr, "[%s] ERROR: Provided argument `struct Token **tokens` is a NULL pointer.\n", __func__);
+		LOG_ERROR("Provided argument `struct Token **tokens` is a NULL pointer.\n");
 		return NULL;
 	}
 
 	if (length == NULL) {
-		fprintf(stderr, "[%s] ERROR: Provided argument `size_t *length` is a NULL pointer.\n", __func__);
+		LOG_ERROR("Provided argument `size_t *length` is a NULL pointer.\n");
 		return NULL;
 	}
 	
 	if (capacity == NULL) {
-		fprintf(stderr, "[%s] ERROR: Provided argument `size_t *capacity` is a NULL pointer.\n", __func__);
+		LOG_ERROR("Provided argument `size_t *capacity` is a NULL pointer.\n");
 		return NULL;
 	}
 	
@@ -280,462 +497,1741 @@ struct Token* tokens_advance(struct Token **tokens, size_t *length, size_t *capa
 
 		void *realloc_pointer = NULL;
 		(*capacity) *= 2;
-		realloc_pointer = (void*) realloc((*tokens), sizeof(struct Token) * (*capacity));
+		if (arena != NULL)
+			realloc_pointer = arena_grow(arena, (*tokens), sizeof(struct Token) * old_capacity, sizeof(struct Token) * (*capacity));
+		else
+			realloc_pointer = (void*) realloc((*tokens), sizeof(struct Token) * (*capacity));
 		if (realloc_pointer == NULL) {
-			fprintf(stderr, "[%s] ERROR: Failed to reallocate the tokens buffer after trying to reallocate for a new capacity of %zu.\n", __func__, (*capacity));
+			LOG_ERROR("Failed to reallocate the tokens buffer after trying to reallocate for a new capacity of %zu.\n", (*capacity));
 			return NULL;
 		}
 
 		(*tokens) = (struct Token*) realloc_pointer;
-		struct Token *first_uninitialized_token = &( (*tokens)[(*length)] );
-		tokens_init(first_uninitialized_token, (*capacity) - (*length));
+		STATS_ADD(tokens_reallocations, 1);
+		STATS_ADD(bytes_allocated, sizeof(struct Token) * (*capacity));
 	}
 	
+	// Slots are only initialized once a token is started in them, so the
+	// unused tail of a generously sized buffer is never even touched
 	struct Token *next_token = &( (*tokens)[(*length)] );
+	tokens_init(next_token, 1);
 	return next_token;
 }
 
-int tokens_handle_special_character(struct Token **tokens, size_t *length, size_t *capacity, struct Token **current_token, struct TokenMetadata **current_metadata, struct TokenizerState *state, char c, size_t index) {
-	if (tokens == NULL) {
-		fprintf(stderr, "[%s] ERROR: Provided argument `struct Token **tokens` is a NULL pointer.\n", __func__);
-		return EXIT_FAILURE;
+struct Token* tokens_advance(struct Token **tokens, size_t *length, size_t *capacity) {
+	return tokens_advance_internal(NULL, tokens, length, capacity);
+}
+
+// Counts where tokens start in data[begin, end). A token starts at every 
+// non-whitespace byte that follows whitespace or a special character, at 
+// every special character, and at every opening quote; nothing inside a 
+// string literal starts one. A backslash and the byte it escapes are one 
+// ordinary character.
+static size_t tokens_estimate_starts(const char *data, size_t begin, size_t end, bool in_quote) {
+	size_t starts = 0;
+	unsigned char previous = (begin > 0) ? char_classes[(unsigned char) data[begin - 1]] : CHAR_CLASS_WHITESPACE;
+	for (size_t i = begin; i < end; i++) {
+		unsigned char class = char_classes[(unsigned char) data[i]];
+		if (class == CHAR_CLASS_BACKSLASH) {
+			i++;
+			class = CHAR_CLASS_ORDINARY;
+		}
+
+		if (class == CHAR_CLASS_QUOTE) {
+			starts += ! in_quote;
+			in_quote = ! in_quote;
+		}
+		else if (! in_quote)
+			starts += class != CHAR_CLASS_WHITESPACE && (previous == CHAR_CLASS_WHITESPACE || previous == CHAR_CLASS_SPECIAL || previous == CHAR_CLASS_QUOTE || class == CHAR_CLASS_SPECIAL);
+		previous = class;
 	}
 
-	if (length == NULL) {
-		fprintf(stderr, "[%s] ERROR: Provided argument `size_t *length` is a NULL pointer.\n", __func__);
+	return starts;
+}
+
+size_t tokens_estimate(const char *data, size_t data_length) {
+	if (data == NULL || data_length == 0)
+		return DEFAULT_TOKENS_AMOUNT;
+
+	// Small inputs are counted in full, larger ones in evenly spread 
+	// samples
+	size_t samples = ESTIMATE_SAMPLES;
+	size_t sample_size = ESTIMATE_SAMPLE_SIZE;
+	if (data_length <= samples * sample_size) {
+		samples = 1;
+		sample_size = data_length;
+	}
+
+	size_t stride = data_length / samples;
+	size_t starts = 0;
+	size_t sampled = 0;
+	for (size_t sample = 0; sample < samples; sample++) {
+		size_t begin = sample * stride;
+		size_t end = (begin + sample_size < data_length) ? begin + sample_size : data_length;
+
+		// Case 1: Whether the sample starts inside a string literal can 
+		//         be told from the quotes since the start of its line.
+		size_t line_start = begin;
+		while (line_start > 0 && begin - line_start < ESTIMATE_SAMPLE_SIZE && data[line_start - 1] != '\n')
+			line_start--;
+
+		if (line_start == 0 || data[line_start - 1] == '\n') {
+			size_t quotes = 0;
+			for (size_t i = line_start; i < begin; i++) {
+				if (data[i] == '\\')
+					i++;
+				else
+					quotes += data[i] == '"';
+			}
+
+			starts += tokens_estimate_starts(data, begin, end, quotes % 2 == 1);
+		}
+		// Case 2: No line start nearby, so count it both ways and keep 
+		//         the larger count
+		else {
+			size_t outside = tokens_estimate_starts(data, begin, end, false);
+			size_t inside = tokens_estimate_starts(data, begin, end, true);
+			starts += (outside > inside) ? outside : inside;
+		}
+		sampled += end - begin;
+	}
+
+	// Scale up to the whole input, with a quarter on top for the parts 
+	// the samples missed. Running over is cheap (slots are initialized
+	// lazily, so untouched ones cost no memory traffic); running short
+	// means copying the whole buffer.
+	size_t estimate = (size_t) ((double) starts * ((double) data_length / (double) sampled));
+	return estimate + (estimate / 4) + 16;
+}
+
+// Sets up a tokenizer whose tokens buffer (of `capacity` tokens) lives in 
+// `arena`, or on the heap when `arena` is NULL.
+static int tokenizer_init(struct Tokenizer *tokenizer, struct Arena *arena, size_t capacity) {
+	// Allocate tokens
+	LOG_DEBUG("Allocating tokens buffer.\n");
+	if (capacity < 2)
+		capacity = 2;
+
+	tokenizer->arena = arena;
+	tokenizer->tokens = (arena != NULL) ? arena_alloc(arena, sizeof(struct Token) * capacity) : malloc(sizeof(struct Token) * capacity);
+	tokenizer->tokens_length = 0;
+	tokenizer->tokens_capacity = capacity;
+	if (tokenizer->tokens == NULL) {
+		LOG_ERROR("Failed to allocate a tokens buffer of %zu tokens.\n", capacity);
 		return EXIT_FAILURE;
 	}
+	STATS_ADD(bytes_allocated, sizeof(struct Token) * capacity);
 	
-	if (capacity == NULL) {
-		fprintf(stderr, "[%s] ERROR: Provided argument `size_t *capacity` is a NULL pointer.\n", __func__);
+	// Only the first slot is initialized; the rest are as they are used
+	tokens_init(tokenizer->tokens, 1);
+	
+	// Keeps track of special behavior (e.g. escaping characters)
+	tokenizer->state = SCAN_STATE_START;
+
+	tokenizer->columns = NULL;
+	tokenizer->compact = NULL;
+	tokenizer->symbols = NULL;
+	tokenizer->keywords = keywords_default();
+	if (tokenizer->keywords == NULL) {
+		LOG_ERROR("Failed to build the default keyword table.\n");
+		tokens_release(arena, tokenizer->tokens, tokenizer->tokens_length);
 		return EXIT_FAILURE;
 	}
 
-	if (current_token == NULL) {
-		fprintf(stderr, "[%s] ERROR: Provided argument `struct Token **current_token` is a NULL pointer.\n", __func__);
-		return EXIT_FAILURE;
+	// Only streaming tokenizers use these
+	tokenizer->base = 0;
+	tokenizer->chunk = NULL;
+	tokenizer->chunk_length = 0;
+	tokenizer->carry = NULL;
+	tokenizer->carry_capacity = 0;
+	tokenizer->scratch = NULL;
+	tokenizer->stopped = false;
+
+	// Only pull tokenizers use these
+	tokenizer->input = NULL;
+	tokenizer->input_length = 0;
+	tokenizer->position = 0;
+	tokenizer->pending = 0;
+	tokenizer->finished = false;
+
+	// Stop sets for the run scanner, built once from the class table
+	pthread_once(&default_classes_once, default_classes_build);
+	tokenizer->classes = &default_classes;
+	tokenizer->spec = NULL;
+	tokenizer->char_classes = char_classes;
+
+	return EXIT_SUCCESS;
+}
+
+// Switches a tokenizer over to the rules of a compiled spec. Only the 
+// special characters change class: those of the built-in rules become 
+// ordinary, and the bytes that start an operator or comment special.
+static void tokenizer_use_spec(struct Tokenizer *tokenizer, const struct TokenSpec *spec) {
+	for (int i = 0; i < 256; i++) {
+		unsigned char class = char_classes[i];
+		if (class == CHAR_CLASS_SPECIAL || class == CHAR_CLASS_ORDINARY)
+			class = spec->starts[i] ? CHAR_CLASS_SPECIAL : CHAR_CLASS_ORDINARY;
+		tokenizer->spec_char_classes[i] = class;
 	}
 
-	if (current_metadata == NULL) {
-		fprintf(stderr, "[%s] ERROR: Provided argument `struct TokenMetdata **current_metadata` is a NULL pointer.\n", __func__);
+	tokenizer->spec = spec;
+	tokenizer->char_classes = tokenizer->spec_char_classes;
+	tokenizer->classes = &(spec->classes);
+	tokenizer->keywords = spec->keyword_table;
+}
+
+// Makes room in the carry buffer for `extra` more bytes of `token` (which
+// lives there) plus a NUL terminator
+static int tokenizer_carry_reserve(struct Tokenizer *tokenizer, struct Token *token, size_t extra) {
+	size_t needed = (size_t) token->value_length + extra + 1;
+	if (needed <= tokenizer->carry_capacity)
+		return EXIT_SUCCESS;
+
+	size_t new_capacity = (tokenizer->carry_capacity == 0) ? 64 : tokenizer->carry_capacity;
+	while (new_capacity < needed)
+		new_capacity *= 2;
+
+	void *realloc_ptr = realloc(tokenizer->carry, new_capacity);
+	if (realloc_ptr == NULL) {
+		LOG_ERROR("Failed to grow the carry buffer to %zu bytes.\n", new_capacity);
 		return EXIT_FAILURE;
 	}
 
-	
-	// Case 1: If we are reading a string literal, then this 
-	//         special symbol is part of it.
-	int status = 0;
-	if (state->quote_opened) {
-		status = token_add_character( (*current_token), c );
-		if (status == EXIT_FAILURE) {
-			fprintf(stderr, "[%s] ERROR: Failed to capture token #%zu. Error occurred on character '%c' at index %zu in the data.\n", __func__, (*length), c, index);
-			tokens_destroy( 
-				(*tokens),
-				(*length)
-			);
-			return EXIT_FAILURE;
-		}
+	tokenizer->carry = (char*) realloc_ptr;
+	tokenizer->carry_capacity = new_capacity;
+	STATS_ADD(bytes_allocated, new_capacity);
+	if (token->value != NULL)
+		token->value = tokenizer->carry;
+	return EXIT_SUCCESS;
+}
+
+// Adds the character at `index` of the current chunk to the token being 
+// read. Usually that just grows the token's span. A token that began in an
+// earlier chunk has its bytes in the carry buffer instead, so the character
+// is appended there.
+static inline int tokenizer_extend(struct Tokenizer *tokenizer, struct Token *token, size_t index, char c) {
+	if (token->value == NULL) {
+		token_span_extend(token, tokenizer->base + index);
+		return EXIT_SUCCESS;
 	}
-	// Case 2: If we are not reading a string literal, then this 
-	//         special character is a token of its own. 
-	//         We must separate from the current token and mark this
-	//         as its own.
-	else {
-		// If whitespace precedes this token, then (*current_token) is already a pointer
-		// to the appropriate token; however, it is possible that an expression was written
-		// without spaces. For example 2+3 does not have spaces.
-		// We should advance a token only if the current token has non-zero length.
-		if ( (*current_token)->value_length > 0 ) {
-			(*current_token) = tokens_advance(tokens, length, capacity);
-			(*current_metadata) = &((*current_token)->metadata);
-			if ( (*current_token) == NULL ) {
-				fprintf(stderr, "[%s] Failed to advance to the next token.\n", __func__);
-				tokens_destroy(
-					(*tokens),
-					(*length)
-				);
-				return EXIT_FAILURE;
-			}
-		}
-		
-		
-		// Tag the token's type
-		switch (c) {
-			case '(':
-				(*current_token)->type = TOKEN_TYPE_LEFT_PARENTHESIS;
-				break;
 
-			case ')':
-				(*current_token)->type = TOKEN_TYPE_RIGHT_PARENTHESIS;
-				break;
-			
-			case '=':
-				(*current_token)->type = TOKEN_TYPE_ASSIGNMENT;
-				break;
-			
-			case '[':
-				(*current_token)->type = TOKEN_TYPE_LEFT_BRACKET;
-				break;
+	if (tokenizer_carry_reserve(tokenizer, token, 1) == EXIT_FAILURE)
+		return EXIT_FAILURE;
 
-			case ']':
-				(*current_token)->type = TOKEN_TYPE_RIGHT_BRACKET;
-				break;
-			
-			case '{':
-				(*current_token)->type = TOKEN_TYPE_LEFT_BRACE;
-				break;
+	token->value[token->value_length] = c;
+	token->value_length++;
+	token->value[token->value_length] = '\0';
+	return EXIT_SUCCESS;
+}
 
-			case '}':
-				(*current_token)->type = TOKEN_TYPE_RIGHT_BRACE;
-				break;
+// Same as tokenizer_extend(), for the `run` characters starting at `index`
+static inline int tokenizer_extend_run(struct Tokenizer *tokenizer, struct Token *token, const char *data, size_t index, size_t run) {
+	if (token->value == NULL) {
+		if (token->value_length == 0)
+			token->offset = tokenizer->base + index;
 
-			case '+':
-				(*current_token)->type = TOKEN_TYPE_PLUS;
-				break;
+		token->value_length += (unsigned int) run;
+		return EXIT_SUCCESS;
+	}
 
-			case '-':
-				(*current_token)->type = TOKEN_TYPE_MINUS;
-				break;
+	if (tokenizer_carry_reserve(tokenizer, token, run) == EXIT_FAILURE)
+		return EXIT_FAILURE;
 
-			case '*':
-				(*current_token)->type = TOKEN_TYPE_ASTERISK;
-				break;
+	memcpy(token->value + token->value_length, data + index, run);
+	token->value_length += (unsigned int) run;
+	token->value[token->value_length] = '\0';
+	return EXIT_SUCCESS;
+}
 
-			case '/':
-				(*current_token)->type = TOKEN_TYPE_SLASH;
-				break;
-			
-			default:
-				fprintf(stderr, "[%s] ERROR: Special character '%c' is unrecognized.\n", __func__, c);
-				return EXIT_FAILURE;
-		}
+// Makes room for `capacity` tokens in every column in use
+static int token_columns_reserve(struct TokenColumns *columns, size_t capacity) {
+	uint8_t *types = realloc(columns->types, sizeof(uint8_t) * capacity);
+	if (types != NULL)
+		columns->types = types;
+
+	size_t *offsets = realloc(columns->offsets, sizeof(size_t) * capacity);
+	if (offsets != NULL)
+		columns->offsets = offsets;
+
+	unsigned int *lengths = realloc(columns->lengths, sizeof(unsigned int) * capacity);
+	if (lengths != NULL)
+		columns->lengths = lengths;
+
+	struct TokenMetadata *metadata = columns->metadata;
+	if (metadata != NULL) {
+		metadata = realloc(columns->metadata, sizeof(struct TokenMetadata) * capacity);
+		if (metadata != NULL)
+			columns->metadata = metadata;
+	}
 
+	union TokenNumber *numbers = columns->numbers;
+	if (numbers != NULL) {
+		numbers = realloc(columns->numbers, sizeof(union TokenNumber) * capacity);
+		if (numbers != NULL)
+			columns->numbers = numbers;
+	}
 
-		// Set the token with the special value
-		status = token_add_character( (*current_token), c );
-		if (status == EXIT_FAILURE) {
-			fprintf(stderr, "[%s] ERROR: Failed to capture token #%zu. Error occurred on character '%c' at index %zu in the data.\n", __func__, (*length), c, index);
-			tokens_destroy( 
-				(*tokens), 
-				(*length) 
-			);
-			return EXIT_FAILURE;
-		}
-		
-		// Advance a token yet again
-		(*current_token) = tokens_advance(tokens, length, capacity);
-		(*current_metadata) = &((*current_token)->metadata);
-		if ( (*current_token) == NULL ) {
-			fprintf(stderr, "[%s] ERROR: Failed to advance to next token.\n", __func__);
-			tokens_destroy( 
-				(*tokens), 
-				(*length)
-			);
-			return EXIT_FAILURE;
-		}
-	}	
+	if (types == NULL || offsets == NULL || lengths == NULL || (columns->metadata != NULL && metadata == NULL) || (columns->numbers != NULL && numbers == NULL)) {
+		LOG_ERROR("Failed to grow the token columns to a capacity of %zu.\n", capacity);
+		return EXIT_FAILURE;
+	}
+
+	STATS_ADD(bytes_allocated, (sizeof(uint8_t) + sizeof(size_t) + sizeof(unsigned int) + ((columns->metadata != NULL) ? sizeof(struct TokenMetadata) + sizeof(union TokenNumber) : 0)) * capacity);
+	columns->capacity = capacity;
+	return EXIT_SUCCESS;
 }
 
-struct Token* tokenize(char *data, size_t data_length, size_t *tokens_length, size_t *tokens_capacity) {
-	if (data == NULL) {
-		fprintf(stderr, "[%s] Provided argument `char *data` is a NULL pointer.\n", __func__);
+// Appends `token` to the columns and clears it, so the same slot is reused
+// for the next token
+static struct Token* tokenizer_push_column(struct TokenColumns *columns, struct Token *token) {
+	if (columns->length == columns->capacity && token_columns_reserve(columns, columns->capacity * 2) == EXIT_FAILURE)
 		return NULL;
+
+	size_t i = columns->length;
+	columns->types[i] = (uint8_t) token->type;
+	columns->offsets[i] = token->offset;
+	columns->lengths[i] = token->value_length;
+	if (columns->metadata != NULL)
+		columns->metadata[i] = token->metadata;
+	if (columns->numbers != NULL)
+		columns->numbers[i] = token->number;
+	columns->length++;
+
+	tokens_init(token, 1);
+	return token;
+}
+
+static int compact_tokens_reserve(struct CompactTokens *compact, size_t capacity) {
+	struct CompactToken *realloc_pointer = realloc(compact->tokens, sizeof(struct CompactToken) * capacity);
+	if (realloc_pointer == NULL) {
+		LOG_ERROR("Failed to grow the compact tokens to a capacity of %zu.\n", capacity);
+		return EXIT_FAILURE;
 	}
-	
-	if (data_length == 0) {
-		fprintf(stderr, "[%s] Provided argument `size_t data_length` is 0.\n", __func__);
-		return NULL;
-	};
-	
-	if (tokens_length == NULL) {
-		fprintf(stderr, "[%s] Provided argument `size_t *tokens_length` is a NULL pointer.\n", __func__);
+
+	STATS_ADD(bytes_allocated, sizeof(struct CompactToken) * capacity);
+	compact->tokens = realloc_pointer;
+	compact->capacity = capacity;
+	return EXIT_SUCCESS;
+}
+
+// Little-endian, byte by byte, so the layout is the same on every machine
+static inline void compact_store(uint8_t *bytes, uint64_t value, size_t size) {
+	for (size_t i = 0; i < size; i++)
+		bytes[i] = (uint8_t) (value >> (8 * i));
+}
+
+static inline uint64_t compact_load(const uint8_t *bytes, size_t size) {
+	uint64_t value = 0;
+	for (size_t i = 0; i < size; i++)
+		value |= ((uint64_t) bytes[i]) << (8 * i);
+	return value;
+}
+
+// Same as tokenizer_push_column(), for tokenize_compact(). `text` is the 
+// token's value.
+static struct Token* tokenizer_push_compact(struct CompactTokens *compact, struct Token *token, const char *text) {
+	if (compact->length == compact->capacity && compact_tokens_reserve(compact, compact->capacity * 2) == EXIT_FAILURE)
 		return NULL;
+
+	struct CompactToken *entry = &(compact->tokens[compact->length]);
+	entry->type = (uint8_t) token->type;
+	entry->flags = token->metadata.numeric_overflow ? COMPACT_TOKEN_OVERFLOW : 0;
+	compact_store(&(entry->bytes[0]), token->offset, 5);
+
+	// Case 1: Short enough to keep inline
+	if (token->value_length <= COMPACT_TOKEN_INLINE_CAPACITY && text != NULL) {
+		entry->flags |= COMPACT_TOKEN_INLINE | (uint8_t) token->value_length;
+		memset(&(entry->bytes[5]), 0, COMPACT_TOKEN_INLINE_CAPACITY);
+		memcpy(&(entry->bytes[5]), text, token->value_length);
 	}
 
-	if (tokens_capacity == NULL) {
-		fprintf(stderr, "[%s] Provided argument `size_t *tokens_capacity` is a NULL pointer.\n", __func__);
-		return NULL;
+	// Case 2: A span of the input
+	else {
+		compact_store(&(entry->bytes[5]), token->value_length, 4);
+		memset(&(entry->bytes[9]), 0, 5);
 	}
-	
-	// Allocate tokens
-	printf("[%s] INFO: Allocating tokens buffer... ", __func__);
-	struct Token *tokens = malloc(sizeof(struct Token) * 128);
-	(*tokens_length) = 0;
-	(*tokens_capacity) = 128; // DEFAULT_TOKENS_AMOUNT;
-	if (tokens == NULL) {
-		fprintf(stderr, "[%s] Failed to allocate default amount of %u tokens on the heap.\n", __func__, DEFAULT_TOKENS_AMOUNT);
-		return NULL;
+
+	compact->length++;
+	tokens_init(token, 1);
+	return token;
+}
+
+// Closes the token being read and returns the next one
+static struct Token* tokenizer_advance(struct Tokenizer *tokenizer) {
+	struct Token *current = &(tokenizer->tokens[tokenizer->tokens_length]);
+
+	const char *text = NULL;
+	if (current->value != NULL)
+		text = current->value;
+	else if (current->value_length == 0)
+		text = "";
+	else if (tokenizer->chunk != NULL)
+		text = tokenizer->chunk + (current->offset - tokenizer->base);
+
+	// Classify the token now, while its bytes are still in cache, rather 
+	// than in a separate pass over every token afterwards. Special 
+	// characters and string literals were typed when they were read.
+	if (current->type == TOKEN_TYPE_NONE && current->value_length > 0 && text != NULL)
+		lex_text(current, text, tokenizer->keywords);
+
+	if (tokenizer->symbols != NULL && text != NULL && (current->type == TOKEN_TYPE_IDENTIFIER || current->type == TOKEN_TYPE_STRING_LITERAL)) {
+		if (symbols_intern(tokenizer->symbols, text, current->value_length, &(current->symbol)) == EXIT_FAILURE) {
+			LOG_ERROR("Failed to intern the token at offset %zu.\n", current->offset);
+			return NULL;
+		}
 	}
-	printf("Done!\n");
-	
-	// Initialize tokens
-	printf("[%s] INFO: Initializing tokens... ", __func__);
-	if (tokens_init(tokens, (*tokens_capacity)) == EXIT_FAILURE) {
-		fprintf(stderr, "[%s] ERROR: Failed to initialize tokens buffer.\n", __func__);
-		tokens_destroy(tokens, (*tokens_capacity));
-		return NULL;
+
+	// A token stitched together across chunks lives in the carry buffer, 
+	// which is about to be reused. Move it to the scratch arena, where it
+	// stays valid until the next chunk is fed.
+	if (current->value != NULL && current->value == tokenizer->carry) {
+		char *copy = arena_alloc(tokenizer->scratch, current->value_length + 1);
+		if (copy == NULL) {
+			LOG_ERROR("Failed to copy a token that spans multiple chunks.\n");
+			return NULL;
+		}
+
+		memcpy(copy, current->value, current->value_length + 1);
+		STATS_ADD(bytes_allocated, current->value_length + 1);
+		current->value = copy;
+		current->value_capacity = current->value_length + 1;
+	}
+
+	if (stats_current != NULL) {
+		stats_current->tokens++;
+		stats_current->tokens_by_type[current->type]++;
+	}
+
+	if (tokenizer->columns != NULL)
+		return tokenizer_push_column(tokenizer->columns, current);
+
+	if (tokenizer->compact != NULL)
+		return tokenizer_push_compact(tokenizer->compact, current, text);
+
+	return tokens_advance_internal(tokenizer->arena, &(tokenizer->tokens), &(tokenizer->tokens_length), &(tokenizer->tokens_capacity));
+}
+
+// Makes the special character `c` a token of its own, ending whatever token
+// was being read
+static int tokenizer_emit_special(struct Tokenizer *tokenizer, char c, size_t index) {
+	struct Token *current_token = &(tokenizer->tokens[tokenizer->tokens_length]);
+	enum TokenType type = special_token_types[(unsigned char) c];
+	if (type == TOKEN_TYPE_NONE) {
+		LOG_ERROR("Special character '%c' is unrecognized.\n", c);
+		return EXIT_FAILURE;
+	}
+
+	// If whitespace precedes this token, then current_token is already a pointer
+	// to the appropriate token; however, it is possible that an expression was written
+	// without spaces. For example 2+3 does not have spaces.
+	// We should advance a token only if the current token has non-zero length.
+	if (current_token->value_length > 0) {
+		current_token = tokenizer_advance(tokenizer);
+		if (current_token == NULL) {
+			LOG_ERROR("Failed to advance to the next token.\n");
+			return EXIT_FAILURE;
+		}
 	}
-	printf("Done!\n");
 	
-	// Internal structure for keeping track of special behavior (e.g. escaping characters)
-	printf("[%s] INFO: Creating TokenizerState struct... ", __func__);
-	struct TokenizerState state = {
-		.ingest_whitespace = 0, 
-		.backslash_opened  = 0,
-		.quote_opened      = 0,
-		.reading_token     = 0
-	}; 
-	printf("Done!\n");
-
-	// Fast lookup for special characters. Greatly reduces amount of
-	// boilerplate code in the switch statement
-	printf("[%s] INFO: Creating special character lookup table... ", __func__);
-	unsigned char special_char_lookup_table[256];
-	for (int i = 0; i < 255; i++)
-		special_char_lookup_table[i] = 0;
-
-	special_char_lookup_table['('] = 1;
-	special_char_lookup_table[')'] = 1;
-	special_char_lookup_table['['] = 1;
-	special_char_lookup_table[']'] = 1;
-	special_char_lookup_table['{'] = 1;
-	special_char_lookup_table['}'] = 1;
-	special_char_lookup_table['+'] = 1;
-	special_char_lookup_table['-'] = 1;
-	special_char_lookup_table['*'] = 1;
-	special_char_lookup_table['/'] = 1;
-	printf("Done!\n");
+	current_token->type = type;
+
+	// Set the token with the special value
+	token_span_extend(current_token, tokenizer->base + index);
+	
+	// Advance a token yet again. The special character ended whatever
+	// token was being read, so the next character starts a fresh one.
+	if (tokenizer_advance(tokenizer) == NULL) {
+		LOG_ERROR("Failed to advance to next token.\n");
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+// Finds the first occurrence of `needle` in `data`, or NULL
+static const char* tokenizer_find(const char *data, size_t data_length, const char *needle, size_t needle_length) {
+	const char *end = data + data_length;
+	while ((size_t) (end - data) >= needle_length) {
+		const char *candidate = memchr(data, needle[0], (size_t) (end - data) - needle_length + 1);
+		if (candidate == NULL)
+			return NULL;
+
+		if (memcmp(candidate, needle, needle_length) == 0)
+			return candidate;
+
+		data = candidate + 1;
+	}
+
+	return NULL;
+}
+
+// Same as tokenizer_emit_special(), by the rules of the tokenizer's spec:
+// takes the longest operator or comment starting at `index`, and leaves in
+// `(*consumed)` how many bytes that was. `(*state)` is the state the 
+// special byte led to.
+static int tokenizer_emit_spec(struct Tokenizer *tokenizer, const char *data, size_t data_length, size_t index, enum ScanState *state, size_t *consumed) {
+	const struct TokenSpec *spec = tokenizer->spec;
+	struct Token *current_token = &(tokenizer->tokens[tokenizer->tokens_length]);
+	size_t entry_index = 0;
+	size_t matched = spec_match(spec, data + index, data_length - index, &entry_index);
+
+	// Case 1: The byte only starts longer operators than there are here,
+	//         so it is ordinary after all (and an ordinary byte outside a 
+	//         string literal always leads to SCAN_STATE_WORD)
+	if (matched == 0) {
+		unsigned char c = (unsigned char) data[index];
+		(*state) = SCAN_STATE_WORD;
+		(*consumed) = 1;
+		current_token->metadata.numeric_digits += (unsigned int) (c - '0') < 10;
+		current_token->metadata.dots += c == '.';
+		return tokenizer_extend(tokenizer, current_token, index, (char) c);
+	}
+
+	// Whatever was being read ends here either way
+	if (current_token->value_length > 0) {
+		current_token = tokenizer_advance(tokenizer);
+		if (current_token == NULL) {
+			LOG_ERROR("Failed to advance to the next token.\n");
+			return EXIT_FAILURE;
+		}
+	}
+
+	const struct SpecEntry *entry = &(spec->entries[entry_index]);
+	switch (entry->kind) {
+		// Case 2: A comment, which separates tokens like whitespace 
+		//         does. An unterminated one runs to the end of the data.
+		case SPEC_ENTRY_LINE_COMMENT:
+		case SPEC_ENTRY_BLOCK_COMMENT: {
+			const char *body = data + index + matched;
+			size_t body_length = data_length - index - matched;
+			const char *end = NULL;
+			if (entry->kind == SPEC_ENTRY_LINE_COMMENT) {
+				end = memchr(body, '\n', body_length);
+				if (end != NULL)
+					end++;
+			}
+			else {
+				end = tokenizer_find(body, body_length, entry->close, entry->close_length);
+				if (end != NULL)
+					end += entry->close_length;
+			}
+
+			(*consumed) = (end != NULL) ? (size_t) (end - (data + index)) : data_length - index;
+			(*state) = SCAN_STATE_START;
+			return EXIT_SUCCESS;
+		}
+
+		// Case 3: An operator
+		case SPEC_ENTRY_OPERATOR:
+			current_token->type = entry->type;
+			current_token->symbol = (uint32_t) entry_index;
+			current_token->offset = tokenizer->base + index;
+			current_token->value_length = (unsigned int) matched;
+			if (tokenizer_advance(tokenizer) == NULL) {
+				LOG_ERROR("Failed to advance to next token.\n");
+				return EXIT_FAILURE;
+			}
+
+			(*consumed) = matched;
+			return EXIT_SUCCESS;
+	}
+
+	return EXIT_FAILURE;
+}
+
+int tokens_handle_special_character(struct Token **tokens, size_t *length, size_t *capacity, struct Token **current_token, struct TokenMetadata **current_metadata, struct TokenizerState *state, char c, size_t index) {
+	if (tokens == NULL) {
+		LOG_ERROR("Provided argument `struct Token **tokens` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (length == NULL) {
+		LOG_ERROR("Provided argument `size_t *length` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
 	
+	if (capacity == NULL) {
+		LOG_ERROR("Provided argument `size_t *capacity` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (current_token == NULL) {
+		LOG_ERROR("Provided argument `struct Token **current_token` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (current_metadata == NULL) {
+		LOG_ERROR("Provided argument `struct TokenMetdata **current_metadata` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (state == NULL) {
+		LOG_ERROR("Provided argument `struct TokenizerState *state` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	// Run the handler on a heap-backed tokenizer wrapped around the 
+	// caller's buffer, then hand the (possibly reallocated) buffer back.
+	struct Tokenizer tokenizer = {
+		.tokens = (*tokens),
+		.tokens_length = (*length),
+		.tokens_capacity = (*capacity),
+		.arena = NULL,
+		.keywords = keywords_default(),
+		.base = 0,
+		.chunk = NULL
+	};
+
+	// Case 1: If we are reading a string literal, then this 
+	//         special symbol is part of it.
+	// Case 2: Otherwise it is a token of its own, and the next character
+	//         starts a fresh one.
+	int status;
+	if (state->quote_opened) {
+		status = tokenizer_extend(&tokenizer, &(tokenizer.tokens[tokenizer.tokens_length]), index, c);
+	}
+	else {
+		status = tokenizer_emit_special(&tokenizer, c, index);
+		state->reading_token = 0;
+	}
+
+	(*tokens) = tokenizer.tokens;
+	(*length) = tokenizer.tokens_length;
+	(*capacity) = tokenizer.tokens_capacity;
+	if (status == EXIT_FAILURE) {
+		tokens_destroy((*tokens), (*length));
+		return EXIT_FAILURE;
+	}
+
+	(*current_token) = &( (*tokens)[(*length)] );
+	(*current_metadata) = &( (*current_token)->metadata );
+	return EXIT_SUCCESS;
+}
+
+// Runs the tokenizer over one chunk of data from `(*start)` on, stopping 
+// early once `stop_after` tokens are complete, and leaves in `(*start)` 
+// where it stopped. The tokenizer's state is kept between calls, so a chunk 
+// may end in the middle of a token or string literal.
+// Every byte costs one lookup in each of the class and transition tables; 
+// the rules themselves live in scan_transitions.
+static int tokenizer_scan_from(struct Tokenizer *tokenizer, const char *data, size_t data_length, size_t *start, size_t stop_after) {
+	enum ScanState state = tokenizer->state;
+	const unsigned char *classes = tokenizer->char_classes;
+	tokenizer->chunk = data;
+	tokenizer->chunk_length = data_length;
+
+	struct StatsTimer timer;
+	stats_timer_start(&timer);
+
 	// Create tokens
-	size_t index  = 0;
+	size_t index  = (*start);
+	size_t run = 0;
+	struct RunCounts counts;
+	struct ScanTransition transition;
 	char c = 0;
-	struct Token *current_token = &(tokens[0]);
+	struct Token *current_token = &(tokenizer->tokens[tokenizer->tokens_length]);
 	struct TokenMetadata *current_metadata = &(current_token->metadata);
-	unsigned int status = 0; 
-	printf("[%s] INFO: Initiating main loop. Index is %zu. Data length is %zu.\n", __func__, index, data_length);
-	while(index < data_length) {
-		printf("Index is %zu. Tokens processed is %zu.\n", index, (*tokens_length));
+	LOG_DEBUG("Initiating main loop. Index is %zu. Data length is %zu.\n", index, data_length);
+	while(index < data_length && tokenizer->tokens_length < stop_after) {
 		c = data[index];
-		// Case: Dealing with a special character
-		printf("[%s] DEBUG: Looking up character \"%c\" in the special character table... ", __func__, c);
-		if ( special_char_lookup_table[c] && state.quote_opened == 0 ) {
-			printf("Found!\n");
-			status = tokens_handle_special_character(
-					&tokens, 
-					tokens_length, 
-					tokens_capacity,
-					&current_token,
-					&current_metadata,
-					&state,
-					c,
-					index
-			);
-			
-			if (status == EXIT_FAILURE) {
-				fprintf(stderr, "[%s] ERROR: Failed to handle special character '%c' at index %zu.\n", __func__, c, index); 
-				tokens_destroy(tokens, (*tokens_length));
-				return NULL;
-			}
+		transition = scan_transitions[state][classes[(unsigned char) c]];
+		state = (enum ScanState) transition.next;
+		LOG_TRACE("Index is %zu. Tokens processed is %zu. Character is '%c'. Action is %d.\n", index, tokenizer->tokens_length, c, transition.action);
+		switch (transition.action) {
+			// Take the whole run of ordinary characters starting here in
+			// one step, counting digits and dots for the metadata (useful 
+			// for lexing) along the way. `c` itself is ordinary, so the 
+			// run is never empty.
+			case SCAN_ACTION_RUN:
+				counts.digits = 0;
+				counts.dots = 0;
+				run = classify_run(tokenizer->classes, data + index, data_length - index, scan_state_in_quote(state), &counts);
+				if (run == 0)
+					run = 1;
+
+				current_metadata->numeric_digits += counts.digits;
+				current_metadata->dots += counts.dots;
+				if (tokenizer_extend_run(tokenizer, current_token, data, index, run) == EXIT_FAILURE)
+					return EXIT_FAILURE;
+				index += run;
+				break;
 
-			index++;		
-			// Do not engage the switch statement
-			continue;
-		}
-		printf("Not found!\n");
+			case SCAN_ACTION_EXTEND:
+				if (tokenizer_extend(tokenizer, current_token, index, c) == EXIT_FAILURE)
+					return EXIT_FAILURE;
+				index++;
+				break;
 
-		// Case: Dealing with an ordinary character
-		switch (c) {
-			case EOF:
-				printf("[%s] DEBUG: Entered EOF case.\n", __func__);
-				return tokens;
+			// Whitespace between tokens does not get added to a token
+			case SCAN_ACTION_SKIP:
+				index += classify_whitespace_run(data + index, data_length - index);
 				break;
 
-			// Space is ignored and marks the end of a token until
-			// something else is read. Just let the whitespace cases fall into
-			// each other.
-			case '\t':
-			case '\n':
-			case ' ':
-				printf("[%s] DEBUG: Entered whitespace case.\n", __func__);
-				// Case 0: Ignore attempts to escape whitespace. Why are you doing that.
-				if (state.backslash_opened)
-					state.backslash_opened = 0;
-
-				// Case 1: If we are not reading a token, then we 
-				//         completely ignore this whitespace. It does not
-				//         get added to a token.
-				if (! state.reading_token ) {
-					index++;
-					break;
+			// Whitespace after a token, or the quote closing a string literal
+			case SCAN_ACTION_CLOSE:
+				current_token = tokenizer_advance(tokenizer);
+				if (current_token == NULL) {
+					LOG_ERROR("Failed to advance to next token. Tokens length was %zu and this breaking character was at index %zu.\n", tokenizer->tokens_length, index);
+					return EXIT_FAILURE;
 				}
-				
-				// Case 2:   We are reading a token
-				// Case 2.1: Special case in which we are not ignoring whitespace 
-				// (e.g. when within a string literal). In this case, 
-				// we are adding the whitespaces to the current token's value
-				if (state.ingest_whitespace) {
-					if (token_add_character(current_token, c) == EXIT_FAILURE) {
-						fprintf(stderr, "[%s] ERROR: Failed to capture token #%zu. Error occurred on character '%c' at index %zu in the data.\n", __func__, (*tokens_length), c, index);
-						tokens_destroy(tokens, (*tokens_length));
-						return NULL;
+				current_metadata = &(current_token->metadata);
+				index++;
+				break;
+
+			case SCAN_ACTION_SPECIAL:
+				if (tokenizer->spec != NULL) {
+					if (tokenizer_emit_spec(tokenizer, data, data_length, index, &state, &run) == EXIT_FAILURE) {
+						LOG_ERROR("Failed to read the operator or comment at index %zu.\n", index);
+						return EXIT_FAILURE;
 					}
 				}
-				// Case 2.2: If we are reading a token, but we are ignoring spaces, 
-				//           then this space means that the current token has ended.
-				//           We are ignoring spaces, so this space has no meaning. 
 				else {
-					if (state.reading_token) {
-						state.reading_token = 0;
-						current_token = tokens_advance(&tokens, tokens_length, tokens_capacity);
-						current_metadata = &(current_token->metadata);
-						if (current_token == NULL) {
-							fprintf(stderr, "[%s] Failed to advance to next token.\n", __func__);
-							tokens_destroy(tokens, (*tokens_length));
-							return NULL;
-						}
+					if (tokenizer_emit_special(tokenizer, c, index) == EXIT_FAILURE) {
+						LOG_ERROR("Failed to handle special character '%c' at index %zu.\n", c, index); 
+						return EXIT_FAILURE;
 					}
+					run = 1;
 				}
 
-				// If we are ignoring the whitespaces, then we are not 
-				// advancing the length of the current token, we are just
-				// trying to get through the spaces.
-				index++;
+				// The tokens buffer may have moved
+				current_token = &(tokenizer->tokens[tokenizer->tokens_length]);
+				current_metadata = &(current_token->metadata);
+				index += run;
 				break;
-			
-			// Escape sequence character
-			// (1) Escaping spaces is NOT permitted.
-			// (2) Escaping quotes is permitted.
-			case '\\':
-				printf("[%s] DEBUG: Entered backslash case.\n", __func__);
-				// Case 1: We have not read a backslash previously, so 
-				//         the next character we read is escaped.
-				if (! state.backslash_opened )
-					state.backslash_opened = 1;
-
-				// Case 2: We HAVE read a backslash previously, so
-				//         the next character is not escaped.
-				else 
-					state.backslash_opened = 0; 
-				
-				// Augment current token
-				if (token_add_character(current_token, c) == EXIT_FAILURE) {
-					fprintf(stderr, "[%s] ERROR: Failed to capture token #%zu. Error occurred on character '%c' at index %zu in the data.\n", __func__, (*tokens_length), c, index);
-					tokens_destroy(tokens, (*tokens_length));
-					return NULL;
+
+			case SCAN_ACTION_OPEN_STRING:
+				// A token's bytes must be contiguous, so a quote 
+				// directly after other characters (e.g. abc"def") ends 
+				// that token and starts the string literal as a new one.
+				if (current_token->value_length > 0) {
+					current_token = tokenizer_advance(tokenizer);
+					if (current_token == NULL) {
+						LOG_ERROR("Failed to advance to next token before opening a string literal at index %zu.\n", index);
+						return EXIT_FAILURE;
+					}
+					current_metadata = &(current_token->metadata);
 				}
+
+				// The literal's value starts after the opening quote. 
+				// Set it explicitly so an empty literal ("") still has one.
+				current_token->type = TOKEN_TYPE_STRING_LITERAL;
+				current_token->offset = tokenizer->base + index + 1;
 				index++;
 				break;
 
-			// Escape spaces  
-			case '"':	
-				printf("[%s] DEBUG: Entered double quote case.\n", __func__);
-				// Case 1: A quote has already been opened, and we are reading a string literal.
-				//         This quote EITHER signifies an escaped quote (Case 1.1) OR it signifies
-				//         the closing of the string literal (Case 1.2)
-				if (state.quote_opened) {
-					// Case 1.1: If a backslash was opened, then this quote is not syntactic, 
-					//           and actually meant to be ingested as part of the data.
-					if (state.backslash_opened) {
-						if (token_add_character(current_token, c) == EXIT_FAILURE) {
-							fprintf(stderr, "[%s] ERROR: Failed to capture token #%zu. Error occurred on character '%c' at index %zu in the data.\n", __func__, (*tokens_length), c, index);
-							tokens_destroy(tokens, (*tokens_length));
-							return NULL;
-						}
-						state.backslash_opened = 0;
-						index++;
-						break;
-					}
-					// Case 1.2: If a quote was opened before, AND a backslash was NOT opened,
-					//           then this quote closes the string literal. This also denotes 
-					//           the end of the token.
-					//           SIDE EFFECTS:
-					//           (1) Spaces are now IGNORED, since the string literal 
-					//               has ended.
-					//           (2) If were reading a token before, we are no longer
-					//               reading that token
-					else {
-						// Closing quote for string literal marks the end of the current
-						// token and the start of a new token.
-						current_token = tokens_advance(&tokens, tokens_length, tokens_capacity);
-						current_metadata = &(current_token->metadata);
-						if (current_token == NULL) {
-							fprintf(stderr, "[%s] ERROR: Failed to advance to next token after processing the final quote in a string literal. Tokens length was %zu and this breaking character was at index %zu.\n", __func__, (*tokens_length), index);
-							tokens_destroy(tokens, (*tokens_length));
-							return NULL;
-						}
-						state.quote_opened = 0;
-						state.ingest_whitespace = 0;
-						state.reading_token = 0;
-						index++;
-					}
-				}
-				// Case 2: If a quote was NOT opened before, then this opens it.
-				//         SIDE EFFECTS:
-				//         (1) Spaces are now NOT ignored, since a string literal
-				//             may contain spaces.
-				//         (2) If we were not reading a token before, we are now 
-				//             reading a token.
-				else {
-					current_token->type = TOKEN_TYPE_STRING_LITERAL;
-					state.quote_opened = 1;
-					state.ingest_whitespace = 1;
-					state.reading_token = 1;
-					// current_token = tokens_advance(&tokens, tokens_length, tokens_capacity);
-					index++;
-				}	
+			// Anything after an EOF marker is ignored.
+			case SCAN_ACTION_STOP:
+				tokenizer->stopped = true;
+				index = data_length;
 				break;
-					
-			// Just reading regular characters, so we add to the token's value
-			default:
-				printf("[%s] DEBUG: Entered regular character case.\n", __func__);
-				printf("[%s] DEBUG: Checking if backslash was opened...\n", __func__);
-				if (state.backslash_opened) {
-					printf("[%s] DEBUG: Backslash was opened!\n", __func__);
-					state.backslash_opened = 0;
-				}
-				
-				/*
-				printf("[%s] DEBUG: Checking if reading_token is active...\n", __func__);
-				if ( ! state.reading_token ) {
-					printf("[%s] DEBUG: Reading token was inactive.\n", __func__);
-					printf("Trying to set reading_token to 1.\n");
-					printf("Success.\n");
-				}
-				*/
-				
-				// Update metdata (useful for lexing)
-				switch (c) {
-					case '.':
-						current_metadata->dots++;
-						break;
-
-					case '0':
-					case '1':
-					case '2':
-					case '3':
-					case '4':
-					case '5':
-					case '6':
-					case '7':
-					case '8':
-					case '9':
-						current_metadata->numeric_digits++;
-						break;
-
-					default:
-						break;	
-				}
+		} // end switch(transition.action)
+	} // end tokenize while
 
-				printf("[%s] DEBUG: Calling `token_add_character`... ", __func__);
-				if (token_add_character(current_token, c) == EXIT_FAILURE) {
-					fprintf(stderr, "[%s] ERROR: Failed to capture token #%zu. Error occurred on character '%c' at index %zu in the data.\n", __func__, (*tokens_length), c, index);
-					tokens_destroy(tokens, (*tokens_length));
-				}
-				else 
-					state.reading_token = 1;
+	tokenizer->state = state;
+	STATS_ADD(bytes_scanned, index - (*start));
+	stats_timer_stop(&timer, STATS_PHASE_SCAN);
+	(*start) = index;
+	return EXIT_SUCCESS;
+} // end tokenizer_scan_from function
 
-				printf("Succeeded.");
-				index++;
-		} // end switch(c)
-	} // end tokenize while
-} // end tokenize function
+// Runs the tokenizer over the whole of one chunk of data
+static int tokenizer_scan(struct Tokenizer *tokenizer, const char *data, size_t data_length) {
+	size_t index = 0;
+	return tokenizer_scan_from(tokenizer, data, data_length, &index, SIZE_MAX);
+}
+
+// The data may end without whitespace after the last token (or in the
+// middle of an unterminated string literal). That token still counts.
+static int tokenizer_flush(struct Tokenizer *tokenizer) {
+	struct Token *current_token = &(tokenizer->tokens[tokenizer->tokens_length]);
+	if (current_token->value_length == 0 && current_token->type == TOKEN_TYPE_NONE)
+		return EXIT_SUCCESS;
+
+	if (tokenizer_advance(tokenizer) == NULL) {
+		LOG_ERROR("Failed to advance past the final token.\n");
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+// Shared by tokenize(), tokenize_interned() and tokenize_arena(). When 
+// `arena` is given, the tokens buffer lives in it and is never freed here.
+static struct Token* tokenize_internal(struct Arena *arena, struct SymbolTable *symbols, const struct TokenSpec *spec, char *data, size_t data_length, size_t capacity_hint, size_t *tokens_length, size_t *tokens_capacity) {
+	if (data == NULL) {
+		LOG_ERROR("Provided argument `char *data` is a NULL pointer.\n");
+		return NULL;
+	}
+	
+	if (tokens_length == NULL) {
+		LOG_ERROR("Provided argument `size_t *tokens_length` is a NULL pointer.\n");
+		return NULL;
+	}
+
+	if (tokens_capacity == NULL) {
+		LOG_ERROR("Provided argument `size_t *tokens_capacity` is a NULL pointer.\n");
+		return NULL;
+	}
+	
+	// Sized once up front, so the buffer (almost) never has to grow
+	if (capacity_hint == 0)
+		capacity_hint = tokens_estimate(data, data_length);
+
+	struct Tokenizer tokenizer;
+	if (tokenizer_init(&tokenizer, arena, capacity_hint + 1) == EXIT_FAILURE)
+		return NULL;
+	tokenizer.symbols = symbols;
+	if (spec != NULL)
+		tokenizer_use_spec(&tokenizer, spec);
+
+	if (tokenizer_scan(&tokenizer, data, data_length) == EXIT_FAILURE || tokenizer_flush(&tokenizer) == EXIT_FAILURE) {
+		tokens_release(arena, tokenizer.tokens, tokenizer.tokens_length);
+		return NULL;
+	}
+
+	(*tokens_length) = tokenizer.tokens_length;
+	(*tokens_capacity) = tokenizer.tokens_capacity;
+	return tokenizer.tokens;
+} // end tokenize_internal function
+
+struct Token* tokenize(char *data, size_t data_length, size_t *tokens_length, size_t *tokens_capacity) {
+	return tokenize_internal(NULL, NULL, NULL, data, data_length, 0, tokens_length, tokens_capacity);
+}
+
+struct Token* tokenize_with_hint(char *data, size_t data_length, size_t capacity_hint, size_t *tokens_length, size_t *tokens_capacity) {
+	return tokenize_internal(NULL, NULL, NULL, data, data_length, capacity_hint, tokens_length, tokens_capacity);
+}
+
+struct Token* tokenize_with_spec(const struct TokenSpec *spec, struct Arena *arena, char *data, size_t data_length, size_t *tokens_length, size_t *tokens_capacity) {
+	if (spec == NULL) {
+		LOG_ERROR("Provided argument `const struct TokenSpec *spec` is a NULL pointer.\n");
+		return NULL;
+	}
+
+	if (! spec->compiled) {
+		LOG_ERROR("The spec has not been compiled.\n");
+		return NULL;
+	}
+
+	size_t arena_capacity = 0;
+	if (tokens_capacity == NULL && arena != NULL)
+		tokens_capacity = &arena_capacity;
+
+	return tokenize_internal(arena, NULL, spec, data, data_length, 0, tokens_length, tokens_capacity);
+}
+
+struct Token* tokenize_interned(struct SymbolTable *symbols, char *data, size_t data_length, size_t *tokens_length, size_t *tokens_capacity) {
+	if (symbols == NULL) {
+		LOG_ERROR("Provided argument `struct SymbolTable *symbols` is a NULL pointer.\n");
+		return NULL;
+	}
+
+	return tokenize_internal(NULL, symbols, NULL, data, data_length, 0, tokens_length, tokens_capacity);
+}
+
+struct Token* tokenize_arena(struct Arena *arena, char *data, size_t data_length, size_t *tokens_length) {
+	if (arena == NULL) {
+		LOG_ERROR("Provided argument `struct Arena *arena` is a NULL pointer.\n");
+		return NULL;
+	}
+
+	size_t tokens_capacity = 0;
+	return tokenize_internal(arena, NULL, NULL, data, data_length, 0, tokens_length, &tokens_capacity);
+}
+
+struct Token* tokenize_file(const char *path, struct Arena *arena, struct Source *source, size_t *tokens_length) {
+	if (source == NULL) {
+		LOG_ERROR("Provided argument `struct Source *source` is a NULL pointer.\n");
+		return NULL;
+	}
+
+	if (tokens_length == NULL) {
+		LOG_ERROR("Provided argument `size_t *tokens_length` is a NULL pointer.\n");
+		return NULL;
+	}
+
+	struct StatsTimer timer;
+	stats_timer_start(&timer);
+	if (source_open(path, source) == EXIT_FAILURE) {
+		LOG_ERROR("Failed to load \"%s\".\n", (path != NULL) ? path : "(null)");
+		return NULL;
+	}
+	stats_timer_stop(&timer, STATS_PHASE_READ);
+
+	size_t tokens_capacity = 0;
+	struct Token *tokens = tokenize_internal(arena, NULL, NULL, source->data, source->length, 0, tokens_length, &tokens_capacity);
+	if (tokens == NULL) {
+		source_close(source);
+		return NULL;
+	}
+
+	return tokens;
+}
+
+// Where the scanner started reading a token: string literals start at 
+// their opening quote, one byte before their value
+static inline size_t token_start(const struct Token *token) {
+	return (token->type == TOKEN_TYPE_STRING_LITERAL) ? token->offset - 1 : token->offset;
+}
+
+static inline bool is_whitespace(char c) {
+	return char_classes[(unsigned char) c] == CHAR_CLASS_WHITESPACE;
+}
+
+int tokenize_edit(struct Token **tokens, size_t *tokens_length, size_t *tokens_capacity, char *data, size_t data_length, size_t edit_start, size_t removed_length, size_t inserted_length) {
+	if (tokens == NULL || (*tokens) == NULL) {
+		LOG_ERROR("Provided argument `struct Token **tokens` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (tokens_length == NULL) {
+		LOG_ERROR("Provided argument `size_t *tokens_length` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (tokens_capacity == NULL) {
+		LOG_ERROR("Provided argument `size_t *tokens_capacity` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (data == NULL && data_length > 0) {
+		LOG_ERROR("Provided argument `char *data` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (edit_start > data_length || inserted_length > data_length - edit_start) {
+		LOG_ERROR("The edit (%zu bytes at %zu) does not fit in the %zu bytes of data.\n", inserted_length, edit_start, data_length);
+		return EXIT_FAILURE;
+	}
+
+	struct Token *old_tokens = (*tokens);
+	size_t old_length = (*tokens_length);
+	size_t edit_end = edit_start + inserted_length;
+
+	// Find the restart point: the last token starting at or before the 
+	// edit with whitespace (or the start of the data) right before it. The
+	// scanner is between tokens there, and so are all the tokens before it
+	// which the edit cannot have changed.
+	size_t low = 0;
+	size_t high = old_length;
+	while (low < high) {
+		size_t middle = low + (high - low) / 2;
+		if (token_start(&(old_tokens[middle])) <= edit_start)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	size_t restart = low;
+	while (restart > 0) {
+		size_t start = token_start(&(old_tokens[restart - 1]));
+		if (start == 0 || is_whitespace(data[start - 1]))
+			break;
+		restart--;
+	}
+
+	size_t position = (restart > 0) ? token_start(&(old_tokens[restart - 1])) : 0;
+	if (restart > 0)
+		restart--;
+
+	struct Tokenizer tokenizer;
+	if (tokenizer_init(&tokenizer, NULL, DEFAULT_TOKENS_AMOUNT) == EXIT_FAILURE)
+		return EXIT_FAILURE;
+
+	// Scan a token at a time until the new tokens line up with old ones.
+	// That happens once the scanner is between tokens, past the edit, at 
+	// whitespace which (being after the edit) the old scanner also saw, 
+	// and an old token starts at the same place. From there on both scans
+	// see the same bytes in the same state, so they agree.
+	size_t resume = old_length;
+	size_t old = restart;
+	int status = EXIT_SUCCESS;
+	while (position < data_length) {
+		status = tokenizer_scan_from(&tokenizer, data, data_length, &position, tokenizer.tokens_length + 1);
+		if (status == EXIT_FAILURE)
+			break;
+
+		struct Token *current = &(tokenizer.tokens[tokenizer.tokens_length]);
+		if (tokenizer.state != SCAN_STATE_START || current->value_length > 0 || current->type != TOKEN_TYPE_NONE)
+			continue;
+
+		size_t next = position + classify_whitespace_run(data + position, data_length - position);
+		if (next == 0 || next - 1 < edit_end || ! is_whitespace(data[next - 1]))
+			continue;
+
+		// Where the next token would have started before the edit
+		size_t old_next = next - inserted_length + removed_length;
+		while (old < old_length && token_start(&(old_tokens[old])) < old_next)
+			old++;
+
+		if (old < old_length && token_start(&(old_tokens[old])) == old_next) {
+			resume = old;
+			break;
+		}
+
+		// The old tokens ran out before this point, so they can't line up
+		if (old == old_length)
+			continue;
+	}
+
+	if (status == EXIT_SUCCESS && resume == old_length)
+		status = tokenizer_flush(&tokenizer);
+
+	if (status == EXIT_FAILURE) {
+		tokens_destroy(tokenizer.tokens, tokenizer.tokens_length);
+		return EXIT_FAILURE;
+	}
+
+	// Splice: the old tokens before the restart point, the new ones, then
+	// the old ones from the resync point on (one spare slot stays at the 
+	// end, like tokenize() leaves).
+	size_t scanned = tokenizer.tokens_length;
+	size_t kept = old_length - resume;
+	size_t new_length = restart + scanned + kept;
+	if (new_length + 1 > (*tokens_capacity)) {
+		size_t new_capacity = (*tokens_capacity);
+		while (new_capacity < new_length + 1)
+			new_capacity *= 2;
+
+		struct Token *realloc_pointer = realloc(old_tokens, sizeof(struct Token) * new_capacity);
+		if (realloc_pointer == NULL) {
+			LOG_ERROR("Failed to grow the tokens buffer to %zu tokens.\n", new_capacity);
+			tokens_destroy(tokenizer.tokens, tokenizer.tokens_length);
+			return EXIT_FAILURE;
+		}
+
+		old_tokens = realloc_pointer;
+		(*tokens) = old_tokens;
+		(*tokens_capacity) = new_capacity;
+		STATS_ADD(tokens_reallocations, 1);
+		STATS_ADD(bytes_allocated, sizeof(struct Token) * new_capacity);
+	}
+
+	for (size_t i = restart; i < resume; i++)
+		free(old_tokens[i].value);
+
+	// The tail is the only part that costs time linear in the input, and 
+	// only when the edit changed the token count or the length
+	if (restart + scanned != resume)
+		memmove(&(old_tokens[restart + scanned]), &(old_tokens[resume]), sizeof(struct Token) * kept);
+
+	if (inserted_length != removed_length) {
+		for (size_t i = restart + scanned; i < new_length; i++)
+			old_tokens[i].offset = old_tokens[i].offset - removed_length + inserted_length;
+	}
+
+	memcpy(&(old_tokens[restart]), tokenizer.tokens, sizeof(struct Token) * scanned);
+	tokens_init(&(old_tokens[new_length]), 1);
+	(*tokens_length) = new_length;
+
+	free(tokenizer.tokens);
+	return EXIT_SUCCESS;
+}
+
+void token_columns_destroy(struct TokenColumns *columns) {
+	if (columns == NULL) {
+		LOG_ERROR("Provided argument `struct TokenColumns *columns` is a NULL pointer.\n");
+		return;
+	}
+
+	free(columns->types);
+	free(columns->offsets);
+	free(columns->lengths);
+	free(columns->metadata);
+	free(columns->numbers);
+	columns->types = NULL;
+	columns->offsets = NULL;
+	columns->lengths = NULL;
+	columns->metadata = NULL;
+	columns->numbers = NULL;
+	columns->length = 0;
+	columns->capacity = 0;
+}
+
+int tokenize_columns(char *data, size_t data_length, struct TokenColumns *columns, bool with_metadata) {
+	if (data == NULL) {
+		LOG_ERROR("Provided argument `char *data` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (columns == NULL) {
+		LOG_ERROR("Provided argument `struct TokenColumns *columns` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	columns->types = NULL;
+	columns->offsets = NULL;
+	columns->lengths = NULL;
+	columns->metadata = NULL;
+	columns->numbers = NULL;
+	columns->length = 0;
+	columns->capacity = 0;
+	if (with_metadata) {
+		columns->metadata = malloc(sizeof(struct TokenMetadata) * DEFAULT_TOKENS_AMOUNT);
+		columns->numbers = malloc(sizeof(union TokenNumber) * DEFAULT_TOKENS_AMOUNT);
+		if (columns->metadata == NULL || columns->numbers == NULL) {
+			LOG_ERROR("Failed to allocate the metadata columns.\n");
+			token_columns_destroy(columns);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (token_columns_reserve(columns, tokens_estimate(data, data_length)) == EXIT_FAILURE) {
+		token_columns_destroy(columns);
+		return EXIT_FAILURE;
+	}
+
+	// Only ever holds the token being read
+	struct Tokenizer tokenizer;
+	if (tokenizer_init(&tokenizer, NULL, 2) == EXIT_FAILURE) {
+		LOG_ERROR("Failed to set up the tokenizer.\n");
+		token_columns_destroy(columns);
+		return EXIT_FAILURE;
+	}
+
+	// The scanner writes into the columns as it closes each token, so 
+	// `tokenizer.tokens` never holds more than the one being read.
+	tokenizer.columns = columns;
+	int status = tokenizer_scan(&tokenizer, data, data_length);
+	if (status == EXIT_SUCCESS)
+		status = tokenizer_flush(&tokenizer);
+
+	tokens_destroy(tokenizer.tokens, 0);
+	if (status == EXIT_FAILURE)
+		token_columns_destroy(columns);
+
+	return status;
+}
+
+void compact_tokens_destroy(struct CompactTokens *compact) {
+	if (compact == NULL) {
+		LOG_ERROR("Provided argument `struct CompactTokens *compact` is a NULL pointer.\n");
+		return;
+	}
+
+	free(compact->tokens);
+	compact->tokens = NULL;
+	compact->length = 0;
+	compact->capacity = 0;
+}
+
+int tokenize_compact(char *data, size_t data_length, struct CompactTokens *compact) {
+	if (data == NULL) {
+		LOG_ERROR("Provided argument `char *data` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (compact == NULL) {
+		LOG_ERROR("Provided argument `struct CompactTokens *compact` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (data_length > COMPACT_TOKEN_MAX_OFFSET) {
+		LOG_ERROR("The input is %zu bytes, too large for compact tokens.\n", data_length);
+		return EXIT_FAILURE;
+	}
+
+	compact->tokens = NULL;
+	compact->length = 0;
+	compact->capacity = 0;
+	if (compact_tokens_reserve(compact, tokens_estimate(data, data_length)) == EXIT_FAILURE)
+		return EXIT_FAILURE;
+
+	// Only ever holds the token being read
+	struct Tokenizer tokenizer;
+	if (tokenizer_init(&tokenizer, NULL, 2) == EXIT_FAILURE) {
+		LOG_ERROR("Failed to set up the tokenizer.\n");
+		compact_tokens_destroy(compact);
+		return EXIT_FAILURE;
+	}
+
+	tokenizer.compact = compact;
+	int status = tokenizer_scan(&tokenizer, data, data_length);
+	if (status == EXIT_SUCCESS)
+		status = tokenizer_flush(&tokenizer);
+
+	tokens_destroy(tokenizer.tokens, 0);
+	if (status == EXIT_FAILURE)
+		compact_tokens_destroy(compact);
+
+	return status;
+}
+
+const char* compact_token_text(const struct CompactToken *token, const char *data, unsigned int *length) {
+	if (token == NULL) {
+		LOG_ERROR("Provided argument `const struct CompactToken *token` is a NULL pointer.\n");
+		return NULL;
+	}
+
+	if (length == NULL) {
+		LOG_ERROR("Provided argument `unsigned int *length` is a NULL pointer.\n");
+		return NULL;
+	}
+
+	if (token->flags & COMPACT_TOKEN_INLINE) {
+		(*length) = token->flags & 0x0F;
+		return (const char*) &(token->bytes[5]);
+	}
+
+	if (data == NULL) {
+		LOG_ERROR("Provided argument `const char *data` is a NULL pointer.\n");
+		return NULL;
+	}
+
+	(*length) = (unsigned int) compact_load(&(token->bytes[5]), 4);
+	return data + compact_token_offset(token);
+}
+
+size_t compact_token_offset(const struct CompactToken *token) {
+	if (token == NULL) {
+		LOG_ERROR("Provided argument `const struct CompactToken *token` is a NULL pointer.\n");
+		return 0;
+	}
+
+	return (size_t) compact_load(&(token->bytes[0]), 5);
+}
+
+int compact_token_number(const struct CompactToken *token, const char *data, union TokenNumber *number) {
+	if (token == NULL) {
+		LOG_ERROR("Provided argument `const struct CompactToken *token` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (number == NULL) {
+		LOG_ERROR("Provided argument `union TokenNumber *number` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (token->type != TOKEN_TYPE_INTEGER_LITERAL && token->type != TOKEN_TYPE_FLOAT_LITERAL)
+		return EXIT_FAILURE;
+
+	unsigned int length = 0;
+	const char *text = compact_token_text(token, data, &length);
+	if (text == NULL)
+		return EXIT_FAILURE;
+
+	if (token->type == TOKEN_TYPE_INTEGER_LITERAL)
+		number_parse_integer(text, length, &(number->integer));
+	else
+		number_parse_float(text, length, &(number->real));
+
+	return EXIT_SUCCESS;
+}
+
+// One slice of the input for tokenize_parallel(). Slices always start right
+// after a newline, where the tokenizer is in one of only two states: 
+// outside a string literal (with nothing pending), or inside one.
+struct TokenizeJob {
+	char *data;
+	size_t start;
+	size_t end;
+	bool starts_in_quote;
+
+	struct Tokenizer tokenizer;
+	int status;
+
+	// Collected by whichever thread runs the job
+	struct TokenizerStats stats;
+
+	// Whether the slice ends inside a string literal, for each of the two
+	// states it could start in
+	bool ends_in_quote;
+	bool ends_in_quote_if_started_in_quote;
+};
+
+// Replays only the state transitions of tokenizer_scan() over a slice to 
+// find out whether it ends inside a string literal. This is much cheaper 
+// than tokenizing, and lets each slice report where it would end up if its
+// speculative start state turns out to be wrong.
+static bool tokenizer_ends_in_quote(const char *data, size_t start, size_t end, enum ScanState state) {
+	struct ScanTransition transition;
+	for (size_t index = start; index < end; index++) {
+		transition = scan_transitions[state][char_classes[(unsigned char) data[index]]];
+		if (transition.action == SCAN_ACTION_STOP)
+			break;
+
+		state = (enum ScanState) transition.next;
+	}
+
+	return scan_state_in_quote(state);
+}
+
+static void* tokenize_job_run(void *argument) {
+	struct TokenizeJob *job = (struct TokenizeJob*) argument;
+	struct Tokenizer *tokenizer = &(job->tokenizer);
+
+	// The calling thread runs one of the jobs too, so put back whatever it
+	// was collecting into when done.
+	struct TokenizerStats *previous_stats = stats_attach(&(job->stats));
+	job->status = tokenizer_init(tokenizer, NULL, tokens_estimate(job->data + job->start, job->end - job->start));
+	if (job->status == EXIT_FAILURE) {
+		stats_attach(previous_stats);
+		return NULL;
+	}
+
+	// Offsets are relative to the whole input, not the slice
+	tokenizer->base = job->start;
+	if (job->starts_in_quote) {
+		tokenizer->state = SCAN_STATE_STRING;
+		tokenizer->tokens[0].type = TOKEN_TYPE_STRING_LITERAL;
+		tokenizer->tokens[0].offset = job->start;
+	}
+	else {
+		// Speculative pass: also work out where the slice would end if it
+		// actually started inside a string literal.
+		job->ends_in_quote_if_started_in_quote = tokenizer_ends_in_quote(job->data, job->start, job->end, SCAN_STATE_STRING);
+	}
+
+	job->status = tokenizer_scan(tokenizer, job->data + job->start, job->end - job->start);
+	if (job->status == EXIT_SUCCESS)
+		job->status = tokenizer_flush(tokenizer);
+
+	job->ends_in_quote = scan_state_in_quote(tokenizer->state);
+	if (job->status == EXIT_FAILURE)
+		tokens_destroy(tokenizer->tokens, tokenizer->tokens_length);
+
+	stats_attach(previous_stats);
+	return NULL;
+}
+
+// Runs the selected jobs (all of them when `selected` is NULL) on their
+// own threads. The calling thread takes the first one itself.
+static int tokenize_jobs_run(struct TokenizeJob *jobs, size_t count, const bool *selected) {
+	pthread_t *threads = malloc(sizeof(pthread_t) * count);
+	bool *started = calloc(count, sizeof(bool));
+	if (threads == NULL || started == NULL) {
+		LOG_ERROR("Failed to allocate %zu threads.\n", count);
+		free(threads);
+		free(started);
+		return EXIT_FAILURE;
+	}
+
+	size_t own_job = count;
+	for (size_t i = 0; i < count; i++) {
+		if (selected != NULL && ! selected[i])
+			continue;
+
+		if (own_job == count) {
+			own_job = i;
+			continue;
+		}
+
+		// Couldn't start a thread; just run the job here instead
+		if (pthread_create(&(threads[i]), NULL, tokenize_job_run, &(jobs[i])) == 0)
+			started[i] = true;
+		else
+			tokenize_job_run(&(jobs[i]));
+	}
+
+	if (own_job < count)
+		tokenize_job_run(&(jobs[own_job]));
+
+	for (size_t i = 0; i < count; i++) {
+		if (started[i])
+			pthread_join(threads[i], NULL);
+	}
+
+	free(threads);
+	free(started);
+	return EXIT_SUCCESS;
+}
+
+struct Token* tokenize_parallel(char *data, size_t data_length, size_t threads, size_t *tokens_length, size_t *tokens_capacity) {
+	if (data == NULL) {
+		LOG_ERROR("Provided argument `char *data` is a NULL pointer.\n");
+		return NULL;
+	}
+
+	if (tokens_length == NULL) {
+		LOG_ERROR("Provided argument `size_t *tokens_length` is a NULL pointer.\n");
+		return NULL;
+	}
+
+	if (tokens_capacity == NULL) {
+		LOG_ERROR("Provided argument `size_t *tokens_capacity` is a NULL pointer.\n");
+		return NULL;
+	}
+
+	if (threads == 0) {
+		long online = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = (online > 0) ? (size_t) online : 1;
+	}
+
+	// Small inputs are not worth the threads. An EOF marker ends the input 
+	// early, which only a front-to-back pass can honor.
+	if (data_length / threads < PARALLEL_MIN_SLICE_SIZE)
+		threads = data_length / PARALLEL_MIN_SLICE_SIZE;
+
+	if (threads <= 1 || memchr(data, EOF, data_length) != NULL)
+		return tokenize(data, data_length, tokens_length, tokens_capacity);
+
+	struct TokenizeJob *jobs = calloc(threads, sizeof(struct TokenizeJob));
+	if (jobs == NULL) {
+		LOG_ERROR("Failed to allocate %zu tokenize jobs.\n", threads);
+		return NULL;
+	}
+
+	struct StatsTimer timer;
+	stats_timer_start(&timer);
+
+	// Cut the input into slices of roughly equal size, moving each cut 
+	// forward to just after the next newline.
+	size_t count = 0;
+	size_t start = 0;
+	for (size_t i = 1; i <= threads && start < data_length; i++) {
+		size_t end = (i == threads) ? data_length : (data_length / threads) * i;
+		if (end < start)
+			end = start;
+
+		if (end < data_length) {
+			char *newline = memchr(data + end, '\n', data_length - end);
+			end = (newline == NULL) ? data_length : (size_t) (newline - data) + 1;
+		}
+
+		jobs[count].data = data;
+		jobs[count].start = start;
+		jobs[count].end = end;
+		jobs[count].starts_in_quote = false;
+		count++;
+		start = end;
+	}
+
+	// Pass 1: Tokenize every slice assuming it starts outside a string 
+	//         literal, which is nearly always true.
+	int status = tokenize_jobs_run(jobs, count, NULL);
+
+	// Pass 2: Walk the slices in order to find their real start states, 
+	//         and redo the (rare) slices whose guess was wrong.
+	bool *redo = calloc(count, sizeof(bool));
+	bool any_redo = false;
+	bool in_quote = false;
+	for (size_t i = 0; i < count && redo != NULL; i++) {
+		if (in_quote) {
+			redo[i] = true;
+			any_redo = true;
+			in_quote = jobs[i].ends_in_quote_if_started_in_quote;
+		}
+		else
+			in_quote = jobs[i].ends_in_quote;
+	}
+
+	if (redo == NULL)
+		status = EXIT_FAILURE;
+
+	for (size_t i = 0; i < count && status == EXIT_SUCCESS; i++) {
+		if (jobs[i].status == EXIT_FAILURE)
+			status = EXIT_FAILURE;
+	}
+
+	if (status == EXIT_SUCCESS && any_redo) {
+		for (size_t i = 0; i < count; i++) {
+			if (! redo[i])
+				continue;
+
+			tokens_destroy(jobs[i].tokenizer.tokens, jobs[i].tokenizer.tokens_length);
+			jobs[i].tokenizer.tokens = NULL;
+			jobs[i].starts_in_quote = true;
+		}
+
+		status = tokenize_jobs_run(jobs, count, redo);
+		for (size_t i = 0; i < count && status == EXIT_SUCCESS; i++) {
+			if (jobs[i].status == EXIT_FAILURE)
+				status = EXIT_FAILURE;
+		}
+	}
+
+	// Merge the slices in order. A slice that starts inside a string 
+	// literal begins with the rest of the literal left open by the 
+	// previous slice, so the two halves are joined back into one token.
+	struct Token *tokens = NULL;
+	size_t total = 0;
+	for (size_t i = 0; i < count && status == EXIT_SUCCESS; i++)
+		total += jobs[i].tokenizer.tokens_length;
+
+	if (status == EXIT_SUCCESS) {
+		tokens = malloc(sizeof(struct Token) * (total + 1));
+		if (tokens == NULL) {
+			LOG_ERROR("Failed to allocate %zu merged tokens.\n", total + 1);
+			status = EXIT_FAILURE;
+		}
+	}
+
+	size_t length = 0;
+	for (size_t i = 0; i < count && status == EXIT_SUCCESS; i++) {
+		struct Token *slice = jobs[i].tokenizer.tokens;
+		size_t slice_length = jobs[i].tokenizer.tokens_length;
+		size_t first = 0;
+		if (jobs[i].starts_in_quote && length > 0 && slice_length > 0) {
+			struct Token *previous = &(tokens[length - 1]);
+			previous->value_length = (unsigned int) (slice[0].offset + slice[0].value_length - previous->offset);
+			previous->metadata.numeric_digits += slice[0].metadata.numeric_digits;
+			previous->metadata.dots += slice[0].metadata.dots;
+			first = 1;
+		}
+
+		memcpy(&(tokens[length]), &(slice[first]), sizeof(struct Token) * (slice_length - first));
+		length += slice_length - first;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		if (jobs[i].tokenizer.tokens != NULL && jobs[i].status == EXIT_SUCCESS)
+			free(jobs[i].tokenizer.tokens);
+	}
+
+	// The work counters of every job (redone ones included) add up, but 
+	// the jobs' scan times overlap and their tokens were counted before 
+	// split literals were joined, so those are taken from here instead.
+	if (stats_current != NULL) {
+		for (size_t i = 0; i < count; i++) {
+			jobs[i].stats.tokens = 0;
+			memset(jobs[i].stats.tokens_by_type, 0, sizeof(jobs[i].stats.tokens_by_type));
+			memset(jobs[i].stats.phases, 0, sizeof(jobs[i].stats.phases));
+			stats_merge(stats_current, &(jobs[i].stats));
+		}
+
+		if (status == EXIT_SUCCESS) {
+			STATS_ADD(bytes_allocated, sizeof(struct Token) * (total + 1));
+			stats_current->tokens += length;
+			for (size_t i = 0; i < length; i++)
+				stats_current->tokens_by_type[tokens[i].type]++;
+		}
+
+		stats_timer_stop(&timer, STATS_PHASE_SCAN);
+	}
+	free(jobs);
+	free(redo);
+
+	if (status == EXIT_FAILURE) {
+		free(tokens);
+		return NULL;
+	}
+
+	// Leave an initialized spare slot, like tokenize() does
+	tokens_init(&(tokens[length]), 1);
+	(*tokens_length) = length;
+	(*tokens_capacity) = total + 1;
+	return tokens;
+}
+
+struct Tokenizer* tokenizer_create(void) {
+	return tokenizer_create_with_keywords(NULL);
+}
+
+struct Tokenizer* tokenizer_create_with_keywords(const struct KeywordTable *keywords) {
+	struct Tokenizer *tokenizer = malloc(sizeof(struct Tokenizer));
+	if (tokenizer == NULL) {
+		LOG_ERROR("Failed to allocate the tokenizer.\n");
+		return NULL;
+	}
+
+	if (tokenizer_init(tokenizer, NULL, DEFAULT_TOKENS_AMOUNT) == EXIT_FAILURE) {
+		free(tokenizer);
+		return NULL;
+	}
+
+	if (keywords != NULL)
+		tokenizer->keywords = keywords;
+
+	// Stitched tokens are copied here and dropped on the next feed, so
+	// this stays about as large as the tokens of a single chunk.
+	tokenizer->scratch = arena_create(64 * 1024);
+	if (tokenizer->scratch == NULL) {
+		tokens_destroy(tokenizer->tokens, tokenizer->tokens_length);
+		free(tokenizer);
+		return NULL;
+	}
+
+	return tokenizer;
+}
+
+void tokenizer_destroy(struct Tokenizer *tokenizer) {
+	if (tokenizer == NULL) {
+		LOG_ERROR("Provided argument `struct Tokenizer *tokenizer` is a NULL pointer.\n");
+		return;
+	}
+
+	// Values of streamed tokens belong to the carry buffer or the scratch
+	// arena, never to the tokens themselves.
+	free(tokenizer->tokens);
+	free(tokenizer->carry);
+	if (tokenizer->scratch != NULL)
+		arena_destroy(tokenizer->scratch);
+	free(tokenizer);
+}
+
+// Drops the tokens completed by the previous feed (the caller has drained
+// them by now) and moves the token still being read to the front.
+static void tokenizer_discard_completed(struct Tokenizer *tokenizer) {
+	if (tokenizer->tokens_length > 0) {
+		tokenizer->tokens[0] = tokenizer->tokens[tokenizer->tokens_length];
+		tokens_init(&(tokenizer->tokens[1]), tokenizer->tokens_length);
+		tokenizer->tokens_length = 0;
+	}
+
+	arena_reset(tokenizer->scratch);
+	tokenizer->base += tokenizer->chunk_length;
+	tokenizer->chunk = NULL;
+	tokenizer->chunk_length = 0;
+}
+
+int tokenizer_set_symbols(struct Tokenizer *tokenizer, struct SymbolTable *symbols) {
+	if (tokenizer == NULL) {
+		LOG_ERROR("Provided argument `struct Tokenizer *tokenizer` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	tokenizer->symbols = symbols;
+	return EXIT_SUCCESS;
+}
+
+int tokenizer_feed(struct Tokenizer *tokenizer, const char *chunk, size_t chunk_length) {
+	if (tokenizer == NULL) {
+		LOG_ERROR("Provided argument `struct Tokenizer *tokenizer` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (chunk == NULL && chunk_length > 0) {
+		LOG_ERROR("Provided argument `const char *chunk` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	tokenizer_discard_completed(tokenizer);
+	if (tokenizer->stopped)
+		return EXIT_SUCCESS;
+
+	tokenizer->chunk = chunk;
+	tokenizer->chunk_length = chunk_length;
+	if (tokenizer_scan(tokenizer, chunk, chunk_length) == EXIT_FAILURE)
+		return EXIT_FAILURE;
+
+	// The chunk may end in the middle of a token (or string literal). Its 
+	// bytes will not be around for the next feed, so move them to the 
+	// carry buffer, where the rest of the token is appended as it arrives.
+	struct Token *current_token = &(tokenizer->tokens[tokenizer->tokens_length]);
+	if (current_token->value != NULL || (current_token->value_length == 0 && current_token->type == TOKEN_TYPE_NONE))
+		return EXIT_SUCCESS;
+
+	if (tokenizer_carry_reserve(tokenizer, current_token, 0) == EXIT_FAILURE)
+		return EXIT_FAILURE;
+
+	memcpy(tokenizer->carry, chunk + (current_token->offset - tokenizer->base), current_token->value_length);
+	tokenizer->carry[current_token->value_length] = '\0';
+	current_token->value = tokenizer->carry;
+	return EXIT_SUCCESS;
+}
+
+struct Token* tokenizer_drain(struct Tokenizer *tokenizer, size_t *tokens_length) {
+	if (tokenizer == NULL) {
+		LOG_ERROR("Provided argument `struct Tokenizer *tokenizer` is a NULL pointer.\n");
+		return NULL;
+	}
+
+	if (tokens_length == NULL) {
+		LOG_ERROR("Provided argument `size_t *tokens_length` is a NULL pointer.\n");
+		return NULL;
+	}
+
+	(*tokens_length) = tokenizer->tokens_length;
+	return tokenizer->tokens;
+}
+
+int tokenizer_finish(struct Tokenizer *tokenizer) {
+	if (tokenizer == NULL) {
+		LOG_ERROR("Provided argument `struct Tokenizer *tokenizer` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	tokenizer_discard_completed(tokenizer);
+	return tokenizer_flush(tokenizer);
+}
+
+struct Tokenizer* tokenizer_open(const char *data, size_t data_length) {
+	if (data == NULL && data_length > 0) {
+		LOG_ERROR("Provided argument `const char *data` is a NULL pointer.\n");
+		return NULL;
+	}
+
+	struct Tokenizer *tokenizer = tokenizer_create();
+	if (tokenizer == NULL)
+		return NULL;
+
+	tokenizer->input = data;
+	tokenizer->input_length = data_length;
+	return tokenizer;
+}
+
+struct Tokenizer* tokenizer_open_with_spec(const struct TokenSpec *spec, const char *data, size_t data_length) {
+	if (spec == NULL) {
+		LOG_ERROR("Provided argument `const struct TokenSpec *spec` is a NULL pointer.\n");
+		return NULL;
+	}
+
+	if (! spec->compiled) {
+		LOG_ERROR("The spec has not been compiled.\n");
+		return NULL;
+	}
+
+	struct Tokenizer *tokenizer = tokenizer_open(data, data_length);
+	if (tokenizer == NULL)
+		return NULL;
+
+	tokenizer_use_spec(tokenizer, spec);
+	return tokenizer;
+}
+
+// Moves the token being read to the front of the buffer once every 
+// completed token has been handed out, so the buffer never grows.
+static void tokenizer_recycle(struct Tokenizer *tokenizer) {
+	if (tokenizer->tokens_length > 0) {
+		tokenizer->tokens[0] = tokenizer->tokens[tokenizer->tokens_length];
+		tokens_init(&(tokenizer->tokens[1]), tokenizer->tokens_length);
+	}
+
+	tokenizer->tokens_length = 0;
+	tokenizer->pending = 0;
+}
+
+enum TokenizerNext tokenizer_next(struct Tokenizer *tokenizer, struct Token *token) {
+	if (tokenizer == NULL) {
+		LOG_ERROR("Provided argument `struct Tokenizer *tokenizer` is a NULL pointer.\n");
+		return TOKENIZER_NEXT_ERROR;
+	}
+
+	if (token == NULL) {
+		LOG_ERROR("Provided argument `struct Token *token` is a NULL pointer.\n");
+		return TOKENIZER_NEXT_ERROR;
+	}
+
+	// A scan may complete more than one token (e.g. "abc(" completes both
+	// "abc" and "("), so only scan again once those are all handed out.
+	if (tokenizer->pending == tokenizer->tokens_length) {
+		tokenizer_recycle(tokenizer);
+
+		// Case 1: Scan until the token being read is complete. 
+		if (tokenizer->position < tokenizer->input_length) {
+			if (tokenizer_scan_from(tokenizer, tokenizer->input, tokenizer->input_length, &(tokenizer->position), 1) == EXIT_FAILURE)
+				return TOKENIZER_NEXT_ERROR;
+		}
+
+		// Case 2: The input ran out first, which completes that token.
+		if (tokenizer->tokens_length == 0 && tokenizer->position >= tokenizer->input_length && ! tokenizer->finished) {
+			tokenizer->finished = true;
+			if (tokenizer_flush(tokenizer) == EXIT_FAILURE)
+				return TOKENIZER_NEXT_ERROR;
+		}
+	}
+
+	if (tokenizer->pending == tokenizer->tokens_length)
+		return TOKENIZER_NEXT_END;
+
+	(*token) = tokenizer->tokens[tokenizer->pending];
+	tokenizer->pending++;
+	return TOKENIZER_NEXT_TOKEN;
+}
+
+const char* tokenizer_token_text(const struct Tokenizer *tokenizer, const struct Token *token) {
+	if (token->value != NULL)
+		return token->value;
+
+	return tokenizer->chunk + (token->offset - tokenizer->base);
+}
@@ -1,5 +1,14 @@
 #ifndef TOKENIZER_H
 #define TOKENIZER_H
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "arena.h"
+#include "source.h"
+#include "keywords.h"
+#include "classify.h"
+#include "symbols.h"
+#include "number.h"
 #define USED_FLAG_BITS 2
 #ifndef __x86_64__
 #define UNUSED_FLAG_BITS 62
@@ -27,7 +36,10 @@ enum TokenType {
 	TOKEN_TYPE_SLASH,
 	TOKEN_TYPE_DOT,
 	TOKEN_TYPE_LEFT_BRACE,
-	TOKEN_TYPE_RIGHT_BRACE
+	TOKEN_TYPE_RIGHT_BRACE,
+	TOKEN_TYPE_IDENTIFIER,
+	TOKEN_TYPE_OPERATOR,
+	TOKEN_TYPE_COUNT
 };
 
 enum TokenizerStateFlag {
@@ -44,17 +56,160 @@ struct TokenizerState {
 	unsigned int reading_token: 1;
 };
 
+// States of the scanner. Each byte's character class and the current state
+// pick an action and the next state from a constant transition table (see
+// tokenizer.c). The ESCAPED states follow an odd number of backslashes.
+enum ScanState {
+	SCAN_STATE_START,
+	SCAN_STATE_START_ESCAPED,
+	SCAN_STATE_WORD,
+	SCAN_STATE_WORD_ESCAPED,
+	SCAN_STATE_STRING,
+	SCAN_STATE_STRING_ESCAPED,
+	SCAN_STATE_COUNT
+};
+
+// `numeric_overflow` is set on integer and float literals whose value did 
+// not fit in the token's `number`
 struct TokenMetadata {
 	unsigned int numeric_digits;
-	unsigned int dots; 
+	unsigned int dots : 31;
+	unsigned int numeric_overflow : 1;
+};
+
+// Value of an integer (`integer`) or float (`real`) literal, converted as
+// the token is read
+union TokenNumber {
+	int64_t integer;
+	double real;
 };
 
+// A token is a span of `value_length` bytes starting at `offset` within the
+// `data` buffer that was passed to tokenize(). The bytes are not copied:
+// `value` stays NULL until an owned copy is requested with token_materialize()
+// (or built up with token_add_character()), in which case `value` and
+// `value_length` describe that NUL-terminated copy instead.
+// When tokenizing with a symbol table, identifiers and string literals also
+// get the id of their text in `symbol` (SYMBOL_NONE otherwise).
+// Integer and float literals carry their value in `number`.
+// Operators read through a token spec (see spec.h) get the index of their
+// rule in the spec in `symbol` instead.
 struct Token {
     char *value;
+    size_t offset;
     unsigned int value_length;
     unsigned int value_capacity;
     struct TokenMetadata metadata;
     enum TokenType type;
+    uint32_t symbol;
+    union TokenNumber number;
+};
+
+// Tokens stored column by column, for consumers that mostly look at the
+// sequence of types (e.g. a parser) and only now and then at the bytes.
+// Token i is `types[i]` (an enum TokenType), spanning `lengths[i]` bytes 
+// from `offsets[i]` of the data. `metadata` and `numbers` are NULL unless 
+// metadata was asked for.
+struct TokenColumns {
+	uint8_t *types;
+	size_t *offsets;
+	unsigned int *lengths;
+	struct TokenMetadata *metadata;
+	union TokenNumber *numbers;
+	size_t length;
+	size_t capacity;
+};
+
+// A token in 16 bytes, for holding every token of a large input at once.
+// Values of up to COMPACT_TOKEN_INLINE_CAPACITY bytes (most identifiers, 
+// keywords, numbers and operators) are copied into the token itself, so 
+// reading them never touches the input; longer ones are a span of the 
+// input, like struct Token. Read it with the compact_token_*() functions.
+//
+//     byte  0      type (an enum TokenType)
+//     byte  1      flags: the inline length in the low 4 bits, then 
+//                  COMPACT_TOKEN_INLINE and COMPACT_TOKEN_OVERFLOW
+//     bytes 2-6    offset (40 bits, little-endian)
+//     bytes 7-15   the value if inline, else its length (32 bits)
+#define COMPACT_TOKEN_INLINE_CAPACITY 9
+#define COMPACT_TOKEN_INLINE 0x10
+#define COMPACT_TOKEN_OVERFLOW 0x20
+#define COMPACT_TOKEN_MAX_OFFSET ((((uint64_t) 1) << 40) - 1)
+struct CompactToken {
+	uint8_t type;
+	uint8_t flags;
+	uint8_t bytes[14];
+};
+
+struct CompactTokens {
+	struct CompactToken *tokens;
+	size_t length;
+	size_t capacity;
+};
+
+// Rules of a dialect (see spec.h)
+struct TokenSpec;
+
+// Everything needed to pick up tokenizing where the last call left off. 
+// tokenize() uses one internally for the whole input; the streaming API 
+// below keeps one alive across chunks.
+struct Tokenizer {
+	enum ScanState state;
+
+	// Completed tokens, followed by the token currently being read
+	struct Token *tokens;
+	size_t tokens_length;
+	size_t tokens_capacity;
+
+	// Backs `tokens` when not NULL, otherwise they are on the heap
+	struct Arena *arena;
+
+	// When not NULL, finished tokens are appended here instead of to 
+	// `tokens`, which then only ever holds the token being read
+	struct TokenColumns *columns;
+
+	// Same as `columns`, for tokenize_compact()
+	struct CompactTokens *compact;
+
+	// Interns identifiers and string literals when not NULL
+	struct SymbolTable *symbols;
+
+	// Keyword set used by tokenizer_lex()
+	const struct KeywordTable *keywords;
+
+	// Streaming only: the chunk being scanned and the absolute offset of 
+	// its first byte. Token offsets are always absolute.
+	size_t base;
+	const char *chunk;
+	size_t chunk_length;
+
+	// Streaming only: bytes of a token that started in an earlier chunk,
+	// and the arena finished tokens of that kind are moved to.
+	char *carry;
+	size_t carry_capacity;
+	struct Arena *scratch;
+
+	// Set once an EOF marker is scanned. Everything after it is ignored, 
+	// including the chunks of any later feeds.
+	bool stopped;
+
+	// Pull API only: the whole input, how far it has been scanned, the 
+	// next completed token to hand out, and whether the end was reached
+	const char *input;
+	size_t input_length;
+	size_t position;
+	size_t pending;
+	bool finished;
+
+	// Shared by every tokenizer
+	const struct CharClasses *classes;
+
+	// Rules other than the built-in ones, or NULL. The class of every byte
+	// is then looked up in `spec_char_classes`, where the bytes that start
+	// an operator or comment are the special ones.
+	const struct TokenSpec *spec;
+	const unsigned char *char_classes;
+	unsigned char spec_char_classes[256];
 };
 
 void tokens_destroy(struct Token *tokens, size_t length);
@@ -71,18 +226,190 @@ enum StorageClass {
     STORAGE_CLASS_POINTER
 };
 
-void token_print(struct Token *token);
-int lex(struct Token *token);
+void token_print(struct Token *token, const char *data);
+// Same as token_print(), to any stream
+void token_fprint(FILE *stream, struct Token *token, const char *data);
+
+// Name of a token type (e.g. "TOKEN_TYPE_KEYWORD")
+const char* token_type_name(enum TokenType type);
+// Classifies a token as an integer or float literal, a keyword or an 
+// identifier. tokenize() and friends already classify every token as they
+// close it, so this is only kept for tokens built by other means; tokens 
+// that already have a type are left alone (and EXIT_FAILURE is returned).
+int lex(struct Token *token, const char *data);
+
+// Same as lex(), but recognizes the keywords in `keywords` instead of the
+// language's default ones
+int lex_keywords(struct Token *token, const char *data, const struct KeywordTable *keywords);
+
+// Returns the bytes of a token: its owned copy if one was materialized, 
+// otherwise a pointer into `data`. The result is NOT NUL-terminated unless
+// the token owns its value; always pair it with `token->value_length`.
+const char* token_text(const struct Token *token, const char *data);
+
+// Gives the token an owned, NUL-terminated copy of its bytes. String literals
+// have their escape sequences (\" and \\) decoded in the copy.
+// Returns the owned copy (also stored in `token->value`), or NULL on failure.
+char* token_materialize(struct Token *token, const char *data);
+
+// Same as token_materialize(), but the copy is allocated from `arena` and 
+// must not be freed with tokens_destroy().
+char* token_materialize_arena(struct Token *token, const char *data, struct Arena *arena);
 
 // Used to not clutter the instructions within tokenize(). Makes sure the tokens buffer
 // is resized as needed.
 // Returns a pointer to the next token
 struct Token* tokens_advance(struct Token **tokens, size_t *length, size_t *capacity); 
 
+// Appends a character to the token's owned value, allocating it if necessary.
+// The tokenizer itself never calls this; it only grows spans.
 int token_add_character(struct Token *token, char c);
 
 // Handles characters such as "(" and ")" which are treated as a whole token outright
 int tokens_handle_special_character(struct Token **tokens, size_t *length, size_t *capacity, struct Token **current_token, struct TokenMetadata **current_metadata, struct TokenizerState *state, char c, size_t index);
 
 struct Token* tokenize(char *data, size_t data_length, size_t *tokens_length, size_t *tokens_capacity);
+
+// Roughly how many tokens `data` holds (erring on the high side), from the
+// separators in a few samples of it. tokenize() sizes its buffer with this
+// so it (almost) never has to grow it.
+size_t tokens_estimate(const char *data, size_t data_length);
+
+// Same as tokenize(), with the tokens buffer sized for `capacity_hint` 
+// tokens instead of an estimate (0 means estimate anyway). It still grows
+// if the hint was too small.
+struct Token* tokenize_with_hint(char *data, size_t data_length, size_t capacity_hint, size_t *tokens_length, size_t *tokens_capacity);
+
+// Same as tokenize(), but every byte of memory (the tokens buffer and any 
+// materialized values) comes from `arena`. Do NOT call tokens_destroy() on
+// the result; release it with arena_destroy(), or call arena_reset() to 
+// reuse the same memory for the next tokenize_arena() call.
+struct Token* tokenize_arena(struct Arena *arena, char *data, size_t data_length, size_t *tokens_length);
+
+// Maps (or, failing that, reads in one go) the file at `path` into `source` 
+// and tokenizes it in place. The tokens are spans into `source->data`, so 
+// keep the source open while using them and close it with source_close() 
+// afterwards. With a NULL `arena` the tokens are heap allocated and must be
+// freed with tokens_destroy().
+struct Token* tokenize_file(const char *path, struct Arena *arena, struct Source *source, size_t *tokens_length);
+
+// Same as tokenize(), but by the rules of a compiled `spec` instead of the
+// built-in special characters and keywords: operators are matched longest
+// first and comments are skipped. With an `arena`, the tokens live in it 
+// (as with tokenize_arena()) and `tokens_capacity` may be NULL.
+struct Token* tokenize_with_spec(const struct TokenSpec *spec, struct Arena *arena, char *data, size_t data_length, size_t *tokens_length, size_t *tokens_capacity);
+
+// Same as tokenize(), but every identifier and string literal is also 
+// interned into `symbols`, and its id stored in the token's `symbol`. String
+// literals are interned as written, escape sequences and all.
+struct Token* tokenize_interned(struct SymbolTable *symbols, char *data, size_t data_length, size_t *tokens_length, size_t *tokens_capacity);
+
+// Brings the tokens tokenize() returned for an input up to date after an 
+// edit replaced the `removed_length` bytes at `edit_start` with 
+// `inserted_length` new ones. `data` is the input after the edit. Scanning 
+// restarts at the last token before the edit that follows whitespace, and 
+// stops as soon as a token after the edit starts where an old one did; the
+// old tokens from there on are kept (with their offsets moved), so the work 
+// grows with the size of the edit rather than the size of the input. 
+// The result is the same as calling tokenize() on the edited input.
+int tokenize_edit(struct Token **tokens, size_t *tokens_length, size_t *tokens_capacity, char *data, size_t data_length, size_t edit_start, size_t removed_length, size_t inserted_length);
+
+// Same as tokenize(), but the tokens are written straight into `columns`
+// (which is overwritten). The metadata and numbers columns are only filled 
+// in when `with_metadata` is true. Free the columns with token_columns_destroy().
+int tokenize_columns(char *data, size_t data_length, struct TokenColumns *columns, bool with_metadata);
+void token_columns_destroy(struct TokenColumns *columns);
+
+// Same as tokenize(), but the tokens are written straight into `compact`
+// (which is overwritten) as struct CompactToken, a third of the size of a
+// struct Token. The values of numeric literals are not kept (only whether
+// they overflowed); compact_token_number() converts them again. Inputs 
+// must be under 1 TiB, so offsets fit in 40 bits. Free the tokens with 
+// compact_tokens_destroy().
+int tokenize_compact(char *data, size_t data_length, struct CompactTokens *compact);
+void compact_tokens_destroy(struct CompactTokens *compact);
+
+// The value of the token and its length. Inline values point into the 
+// token (and are not NUL-terminated); others point into `data`.
+const char* compact_token_text(const struct CompactToken *token, const char *data, unsigned int *length);
+size_t compact_token_offset(const struct CompactToken *token);
+
+// Converts an integer or float literal. Returns EXIT_FAILURE for other 
+// tokens. The token's COMPACT_TOKEN_OVERFLOW flag says whether it fit.
+int compact_token_number(const struct CompactToken *token, const char *data, union TokenNumber *number);
+
+// Tokenizes the input on `threads` threads (0 for one per online CPU) and
+// returns the same tokens tokenize() would. The input is cut into slices
+// at newlines; each slice is tokenized assuming it does not start inside a
+// string literal, and the few slices where that guess was wrong are redone
+// once the real states are known. Small inputs are tokenized on the 
+// calling thread. Free the result with tokens_destroy().
+struct Token* tokenize_parallel(char *data, size_t data_length, size_t threads, size_t *tokens_length, size_t *tokens_capacity);
+
+// Streaming API. Feed the input in chunks of any size, and drain the tokens
+// each chunk completed before feeding the next one:
+//
+//     struct Tokenizer *tokenizer = tokenizer_create();
+//     while (/* more input */) {
+//         tokenizer_feed(tokenizer, chunk, chunk_length);
+//         tokens = tokenizer_drain(tokenizer, &tokens_length);
+//         ...
+//     }
+//     tokenizer_finish(tokenizer);
+//     tokens = tokenizer_drain(tokenizer, &tokens_length);
+//     tokenizer_destroy(tokenizer);
+//
+// Drained tokens (and their text) are valid until the next feed or finish,
+// which discards them. As with tokenize(), the input ends at the first EOF 
+// marker, so chunks fed after the one holding it are dropped. A token split between chunks is stitched together
+// and handed out as an owned value, so memory stays bounded by the chunk 
+// size rather than the input size.
+struct Tokenizer* tokenizer_create(void);
+
+// Same as tokenizer_create(), with a keyword set other than the default one
+// (see keywords_create()). The table must outlive the tokenizer.
+struct Tokenizer* tokenizer_create_with_keywords(const struct KeywordTable *keywords);
+void tokenizer_destroy(struct Tokenizer *tokenizer);
+
+// Interns the identifiers and string literals of every token from now on
+// into `symbols` (see tokenize_interned()). The table must outlive the 
+// tokenizer; NULL stops interning.
+int tokenizer_set_symbols(struct Tokenizer *tokenizer, struct SymbolTable *symbols);
+int tokenizer_feed(struct Tokenizer *tokenizer, const char *chunk, size_t chunk_length);
+struct Token* tokenizer_drain(struct Tokenizer *tokenizer, size_t *tokens_length);
+
+// Ends the input, completing the token still being read (if any)
+int tokenizer_finish(struct Tokenizer *tokenizer);
+
+// Pull API. Tokens are produced one at a time, scanning only as far as 
+// needed for the next one, and no array of every token is ever built:
+//
+//     struct Tokenizer *tokenizer = tokenizer_open(data, data_length);
+//     struct Token token;
+//     while (tokenizer_next(tokenizer, &token) == TOKENIZER_NEXT_TOKEN) {
+//         /* token_text(&token, data) ... */
+//     }
+//     tokenizer_destroy(tokenizer);
+//
+// `data` must outlive the tokenizer. Tokens are spans into it, exactly as
+// tokenize() would return them. Stopping early is fine.
+enum TokenizerNext {
+	TOKENIZER_NEXT_ERROR = -1,
+	TOKENIZER_NEXT_END = 0,
+	TOKENIZER_NEXT_TOKEN = 1
+};
+
+struct Tokenizer* tokenizer_open(const char *data, size_t data_length);
+
+// Same as tokenizer_open(), tokenizing by the rules of a compiled `spec`,
+// which must outlive the tokenizer
+struct Tokenizer* tokenizer_open_with_spec(const struct TokenSpec *spec, const char *data, size_t data_length);
+enum TokenizerNext tokenizer_next(struct Tokenizer *tokenizer, struct Token *token);
+
+// Like token_text(), for tokens drained from a streaming tokenizer
+const char* tokenizer_token_text(const struct Tokenizer *tokenizer, const struct Token *token);
+
+// Like lex(), for tokens drained from a streaming tokenizer, using the 
+// tokenizer's keyword set. Streamed tokens are classified already.
+int tokenizer_lex(const struct Tokenizer *tokenizer, struct Token *token);
 #endif
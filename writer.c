@@ -0,0 +1,439 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <math.h>
+#include <unistd.h>
+#include "writer.h"
+#include "tokenizer.h"
+#include "log.h"
+#define WRITER_MEMORY_INITIAL_SIZE 4096
+
+// Longest a formatted number can get (20 digits for a uint64_t, or a %.17g
+// double with its sign, exponent and all)
+#define WRITER_NUMBER_SIZE 32
+
+#define WRITER_PUT_LITERAL(writer, literal) writer_put((writer), (literal), sizeof(literal) - 1)
+
+static const char *writer_format_names[] = {
+	[WRITER_FORMAT_TEXT]   = "text",
+	[WRITER_FORMAT_JSON]   = "json",
+	[WRITER_FORMAT_BINARY] = "binary"
+};
+
+// How each byte is written inside a JSON string: 0 as is, otherwise the
+// character that follows a backslash ('u' for a \u00XX escape)
+static const char json_escapes[256] = {
+	['\b'] = 'b', ['\f'] = 'f', ['\n'] = 'n', ['\r'] = 'r', ['\t'] = 't',
+	['"'] = '"', ['\\'] = '\\',
+	[0x00] = 'u', [0x01] = 'u', [0x02] = 'u', [0x03] = 'u', [0x04] = 'u',
+	[0x05] = 'u', [0x06] = 'u', [0x07] = 'u', [0x0B] = 'u', [0x0E] = 'u',
+	[0x0F] = 'u', [0x10] = 'u', [0x11] = 'u', [0x12] = 'u', [0x13] = 'u',
+	[0x14] = 'u', [0x15] = 'u', [0x16] = 'u', [0x17] = 'u', [0x18] = 'u',
+	[0x19] = 'u', [0x1A] = 'u', [0x1B] = 'u', [0x1C] = 'u', [0x1D] = 'u',
+	[0x1E] = 'u', [0x1F] = 'u', [0x7F] = 'u'
+};
+
+int writer_format_from_string(const char *string, enum WriterFormat *format) {
+	if (string == NULL || format == NULL)
+		return EXIT_FAILURE;
+
+	for (int i = WRITER_FORMAT_TEXT; i <= WRITER_FORMAT_BINARY; i++) {
+		if (strcasecmp(string, writer_format_names[i]) == 0) {
+			(*format) = (enum WriterFormat) i;
+			return EXIT_SUCCESS;
+		}
+	}
+
+	return EXIT_FAILURE;
+}
+
+static struct Writer* writer_create_internal(int fd, enum WriterFormat format, size_t capacity) {
+	struct Writer *writer = malloc(sizeof(struct Writer));
+	if (writer == NULL) {
+		LOG_ERROR("Failed to allocate a writer.\n");
+		return NULL;
+	}
+
+	writer->buffer = malloc(capacity);
+	if (writer->buffer == NULL) {
+		LOG_ERROR("Failed to allocate a %zu byte output buffer.\n", capacity);
+		free(writer);
+		return NULL;
+	}
+
+	writer->fd = fd;
+	writer->format = format;
+	writer->length = 0;
+	writer->capacity = capacity;
+	writer->failed = false;
+	for (int i = 0; i < TOKEN_TYPE_COUNT; i++)
+		writer->type_name_lengths[i] = (unsigned char) strlen(token_type_name((enum TokenType) i));
+
+	return writer;
+}
+
+struct Writer* writer_create(int fd, enum WriterFormat format) {
+	if (fd < 0) {
+		LOG_ERROR("Provided argument `int fd` is not a file descriptor.\n");
+		return NULL;
+	}
+
+	struct Writer *writer = writer_create_internal(fd, format, WRITER_BUFFER_SIZE);
+	if (writer != NULL && format == WRITER_FORMAT_BINARY)
+		writer_write(writer, WRITER_BINARY_MAGIC, strlen(WRITER_BINARY_MAGIC));
+
+	return writer;
+}
+
+struct Writer* writer_create_memory(enum WriterFormat format) {
+	return writer_create_internal(-1, format, WRITER_MEMORY_INITIAL_SIZE);
+}
+
+int writer_flush(struct Writer *writer) {
+	if (writer == NULL) {
+		LOG_ERROR("Provided argument `struct Writer *writer` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (writer->fd < 0 || writer->length == 0)
+		return (writer->failed) ? EXIT_FAILURE : EXIT_SUCCESS;
+
+	size_t written = 0;
+	while (written < writer->length) {
+		ssize_t result = write(writer->fd, writer->buffer + written, writer->length - written);
+		if (result < 0) {
+			if (errno == EINTR)
+				continue;
+
+			LOG_ERROR("Failed to write the output: %s.\n", strerror(errno));
+			writer->failed = true;
+			break;
+		}
+
+		written += (size_t) result;
+	}
+
+	writer->length = 0;
+	return (writer->failed) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int writer_destroy(struct Writer *writer) {
+	if (writer == NULL) {
+		LOG_ERROR("Provided argument `struct Writer *writer` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	int status = writer_flush(writer);
+	free(writer->buffer);
+	free(writer);
+	return status;
+}
+
+// Makes room for `size` more bytes: a file writer flushes when the buffer
+// is full, a memory writer (or one asked for more than a whole buffer)
+// grows it
+static int writer_reserve(struct Writer *writer, size_t size) {
+	// Once a write failed, nothing more is written (or logged)
+	if (writer->failed)
+		return EXIT_FAILURE;
+
+	if (writer->length + size <= writer->capacity)
+		return EXIT_SUCCESS;
+
+	if (writer->fd >= 0 && writer_flush(writer) == EXIT_FAILURE)
+		return EXIT_FAILURE;
+
+	if (writer->length + size <= writer->capacity)
+		return EXIT_SUCCESS;
+
+	size_t new_capacity = writer->capacity;
+	while (new_capacity < writer->length + size)
+		new_capacity *= 2;
+
+	char *realloc_pointer = realloc(writer->buffer, new_capacity);
+	if (realloc_pointer == NULL) {
+		LOG_ERROR("Failed to grow the output buffer to %zu bytes.\n", new_capacity);
+		writer->failed = true;
+		return EXIT_FAILURE;
+	}
+
+	writer->buffer = realloc_pointer;
+	writer->capacity = new_capacity;
+	return EXIT_SUCCESS;
+}
+
+static inline void writer_put(struct Writer *writer, const char *bytes, size_t length) {
+	memcpy(writer->buffer + writer->length, bytes, length);
+	writer->length += length;
+}
+
+static inline void writer_put_u8(struct Writer *writer, uint8_t value) {
+	writer->buffer[writer->length] = (char) value;
+	writer->length++;
+}
+
+static inline void writer_put_le(struct Writer *writer, uint64_t value, size_t bytes) {
+	for (size_t i = 0; i < bytes; i++)
+		writer->buffer[writer->length + i] = (char) (value >> (8 * i));
+	writer->length += bytes;
+}
+
+// Decimal digits of `value`, without going through printf
+static inline void writer_put_unsigned(struct Writer *writer, uint64_t value) {
+	char digits[WRITER_NUMBER_SIZE];
+	size_t position = sizeof(digits);
+	do {
+		position--;
+		digits[position] = (char) ('0' + (value % 10));
+		value /= 10;
+	} while (value != 0);
+
+	writer_put(writer, digits + position, sizeof(digits) - position);
+}
+
+// Shortest of %.15g, %.16g and %.17g that reads back as the same double
+static void writer_put_double(struct Writer *writer, double value) {
+	char text[WRITER_NUMBER_SIZE];
+	int length = 0;
+	for (int precision = 15; precision <= 17; precision++) {
+		length = snprintf(text, sizeof(text), "%.*g", precision, value);
+		if (strtod(text, NULL) == value)
+			break;
+	}
+
+	writer_put(writer, text, (size_t) length);
+}
+
+// Room needed for `length` bytes once escaped for JSON (worst case)
+static inline size_t json_escaped_size(size_t length) {
+	return length * 6;
+}
+
+static void writer_put_json_string(struct Writer *writer, const char *text, size_t length) {
+	static const char hex[] = "0123456789abcdef";
+	writer_put_u8(writer, '"');
+	size_t start = 0;
+	for (size_t i = 0; i < length; i++) {
+		unsigned char c = (unsigned char) text[i];
+		char escape = json_escapes[c];
+		if (escape == 0)
+			continue;
+
+		writer_put(writer, text + start, i - start);
+		start = i + 1;
+		writer_put_u8(writer, '\\');
+		writer_put_u8(writer, (uint8_t) escape);
+		if (escape == 'u') {
+			WRITER_PUT_LITERAL(writer, "00");
+			writer_put_u8(writer, (uint8_t) hex[c >> 4]);
+			writer_put_u8(writer, (uint8_t) hex[c & 0xF]);
+		}
+	}
+
+	writer_put(writer, text + start, length - start);
+	writer_put_u8(writer, '"');
+}
+
+static inline bool writer_has_number(const struct Token *token) {
+	return token->type == TOKEN_TYPE_INTEGER_LITERAL || token->type == TOKEN_TYPE_FLOAT_LITERAL;
+}
+
+int writer_token(struct Writer *writer, const struct Token *token, const char *data) {
+	if (writer == NULL) {
+		LOG_ERROR("Provided argument `struct Writer *writer` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (token == NULL) {
+		LOG_ERROR("Provided argument `const struct Token *token` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	const char *text = (token->value != NULL || data != NULL) ? token_text(token, data) : NULL;
+	size_t text_length = (text != NULL) ? token->value_length : 0;
+	const char *type_name = token_type_name(token->type);
+	size_t type_name_length = ((unsigned int) token->type < TOKEN_TYPE_COUNT) ? writer->type_name_lengths[token->type] : strlen(type_name);
+
+	switch (writer->format) {
+		case WRITER_FORMAT_TEXT:
+			if (writer_reserve(writer, text_length + type_name_length + 64) == EXIT_FAILURE)
+				return EXIT_FAILURE;
+
+			if (text != NULL) {
+				WRITER_PUT_LITERAL(writer, "Value: \"");
+				writer_put(writer, text, text_length);
+				WRITER_PUT_LITERAL(writer, "\"\nType: ");
+			}
+			else
+				WRITER_PUT_LITERAL(writer, "Value: <NULL (maybe something went wrong?)>\nType: ");
+
+			writer_put(writer, type_name, type_name_length);
+			WRITER_PUT_LITERAL(writer, "\n\n");
+			break;
+
+		case WRITER_FORMAT_JSON:
+			if (writer_reserve(writer, json_escaped_size(text_length) + type_name_length + 128) == EXIT_FAILURE)
+				return EXIT_FAILURE;
+
+			WRITER_PUT_LITERAL(writer, "{\"type\":\"");
+			writer_put(writer, type_name, type_name_length);
+			WRITER_PUT_LITERAL(writer, "\",\"offset\":");
+			writer_put_unsigned(writer, token->offset);
+			WRITER_PUT_LITERAL(writer, ",\"length\":");
+			writer_put_unsigned(writer, token->value_length);
+			WRITER_PUT_LITERAL(writer, ",\"value\":");
+			if (text != NULL)
+				writer_put_json_string(writer, text, text_length);
+			else
+				WRITER_PUT_LITERAL(writer, "null");
+
+			if (writer_has_number(token)) {
+				WRITER_PUT_LITERAL(writer, ",\"number\":");
+				// JSON has no infinity; a float that overflowed is null
+				if (token->type == TOKEN_TYPE_FLOAT_LITERAL && ! isfinite(token->number.real))
+					WRITER_PUT_LITERAL(writer, "null");
+				else if (token->type == TOKEN_TYPE_FLOAT_LITERAL)
+					writer_put_double(writer, token->number.real);
+				else if (token->number.integer < 0) {
+					writer_put_u8(writer, '-');
+					writer_put_unsigned(writer, -(uint64_t) token->number.integer);
+				}
+				else
+					writer_put_unsigned(writer, (uint64_t) token->number.integer);
+
+				if (token->metadata.numeric_overflow)
+					WRITER_PUT_LITERAL(writer, ",\"overflow\":true");
+			}
+			WRITER_PUT_LITERAL(writer, "}\n");
+			break;
+
+		case WRITER_FORMAT_BINARY: {
+			if (writer_reserve(writer, text_length + 22) == EXIT_FAILURE)
+				return EXIT_FAILURE;
+
+			writer_put_u8(writer, (uint8_t) token->type);
+			writer_put_u8(writer, token->metadata.numeric_overflow);
+			writer_put_le(writer, text_length, 4);
+			writer_put_le(writer, token->offset, 8);
+			if (text_length > 0)
+				writer_put(writer, text, text_length);
+			if (writer_has_number(token)) {
+				uint64_t bits;
+				memcpy(&bits, &(token->number), sizeof(bits));
+				writer_put_le(writer, bits, 8);
+			}
+			break;
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
+
+int writer_file(struct Writer *writer, const char *path) {
+	if (writer == NULL) {
+		LOG_ERROR("Provided argument `struct Writer *writer` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (path == NULL) {
+		LOG_ERROR("Provided argument `const char *path` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	size_t path_length = strlen(path);
+	if (writer_reserve(writer, json_escaped_size(path_length) + 32) == EXIT_FAILURE)
+		return EXIT_FAILURE;
+
+	switch (writer->format) {
+		case WRITER_FORMAT_TEXT:
+			WRITER_PUT_LITERAL(writer, "File: \"");
+			writer_put(writer, path, path_length);
+			WRITER_PUT_LITERAL(writer, "\"\n\n");
+			break;
+
+		case WRITER_FORMAT_JSON:
+			WRITER_PUT_LITERAL(writer, "{\"file\":");
+			writer_put_json_string(writer, path, path_length);
+			WRITER_PUT_LITERAL(writer, "}\n");
+			break;
+
+		case WRITER_FORMAT_BINARY:
+			writer_put_u8(writer, WRITER_BINARY_FILE_RECORD);
+			writer_put_u8(writer, 0);
+			writer_put_le(writer, path_length, 4);
+			writer_put_le(writer, 0, 8);
+			writer_put(writer, path, path_length);
+			break;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+int writer_write(struct Writer *writer, const char *bytes, size_t length) {
+	if (writer == NULL) {
+		LOG_ERROR("Provided argument `struct Writer *writer` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (bytes == NULL && length > 0) {
+		LOG_ERROR("Provided argument `const char *bytes` is a NULL pointer.\n");
+		return EXIT_FAILURE;
+	}
+
+	// Anything bigger than the buffer goes straight out after what is
+	// already buffered
+	if (writer->fd >= 0 && length >= writer->capacity) {
+		if (writer_flush(writer) == EXIT_FAILURE)
+			return EXIT_FAILURE;
+
+		size_t written = 0;
+		while (written < length) {
+			ssize_t result = write(writer->fd, bytes + written, length - written);
+			if (result < 0) {
+				if (errno == EINTR)
+					continue;
+
+				LOG_ERROR("Failed to write the output: %s.\n", strerror(errno));
+				writer->failed = true;
+				return EXIT_FAILURE;
+			}
+
+			written += (size_t) result;
+		}
+
+		return EXIT_SUCCESS;
+	}
+
+	if (writer_reserve(writer, length) == EXIT_FAILURE)
+		return EXIT_FAILURE;
+
+	writer_put(writer, bytes, length);
+	return EXIT_SUCCESS;
+}
+
+int writer_take(struct Writer *writer, char **buffer, size_t *length) {
+	if (writer == NULL || buffer == NULL || length == NULL) {
+		LOG_ERROR("Provided argument `%s` is a NULL pointer.\n", (writer == NULL) ? "struct Writer *writer" : (buffer == NULL) ? "char **buffer" : "size_t *length");
+		return EXIT_FAILURE;
+	}
+
+	if (writer->fd >= 0) {
+		LOG_ERROR("Only the buffer of a memory writer can be taken.\n");
+		return EXIT_FAILURE;
+	}
+
+	char *fresh = malloc(WRITER_MEMORY_INITIAL_SIZE);
+	if (fresh == NULL) {
+		LOG_ERROR("Failed to allocate a %d byte output buffer.\n", WRITER_MEMORY_INITIAL_SIZE);
+		return EXIT_FAILURE;
+	}
+
+	(*buffer) = writer->buffer;
+	(*length) = writer->length;
+	writer->buffer = fresh;
+	writer->length = 0;
+	writer->capacity = WRITER_MEMORY_INITIAL_SIZE;
+	return EXIT_SUCCESS;
+}
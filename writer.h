@@ -0,0 +1,80 @@
+#ifndef WRITER_H
+#define WRITER_H
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "tokenizer.h"
+#define WRITER_BUFFER_SIZE (1024 * 1024)
+#define WRITER_BINARY_MAGIC "TOKBIN01"
+#define WRITER_BINARY_FILE_RECORD 0xFF
+
+// Output formats:
+//
+// TEXT   What token_print() writes: "Value: ..." and "Type: ..." lines.
+// JSON   One JSON object per line (JSON Lines), with the token's type,
+//        offset, length and value, plus "number" (and "overflow") for
+//        numeric literals. Bytes that are not valid in a JSON string are
+//        escaped; others (including non-ASCII ones) are written as is.
+// BINARY The magic WRITER_BINARY_MAGIC, then one record per token, with
+//        every number little-endian:
+//
+//            uint8_t  type           enum TokenType
+//            uint8_t  flags          bit 0: numeric_overflow
+//            uint32_t length
+//            uint64_t offset
+//            char     value[length]
+//            uint64_t number         only for integer and float literals
+//                                    (the bits of the int64_t or double)
+//
+//        In batch mode each file starts with a record of type
+//        WRITER_BINARY_FILE_RECORD whose value is the path (its flags and
+//        offset are 0, and it has no number).
+enum WriterFormat {
+	WRITER_FORMAT_TEXT,
+	WRITER_FORMAT_JSON,
+	WRITER_FORMAT_BINARY
+};
+
+// Formats tokens into one large buffer. A writer either writes the buffer
+// to a file descriptor whenever it fills up, or (with `fd` -1) keeps
+// everything in memory for writer_take().
+struct Writer {
+	int fd;
+	enum WriterFormat format;
+	char *buffer;
+	size_t length;
+	size_t capacity;
+	bool failed;
+
+	// Lengths of the type names, so they can be copied without strlen()
+	unsigned char type_name_lengths[TOKEN_TYPE_COUNT];
+};
+
+int writer_format_from_string(const char *string, enum WriterFormat *format);
+
+// A writer to `fd`. Binary output gets its magic right away.
+struct Writer* writer_create(int fd, enum WriterFormat format);
+
+// A writer that only fills its buffer. Binary output gets no magic, since
+// the buffer is meant to be appended to another writer's output.
+struct Writer* writer_create_memory(enum WriterFormat format);
+
+// Flushes whatever is left and frees the writer. Returns EXIT_FAILURE if
+// any write failed along the way.
+int writer_destroy(struct Writer *writer);
+
+int writer_token(struct Writer *writer, const struct Token *token, const char *data);
+
+// Marks the start of the tokens of the file at `path` (batch mode)
+int writer_file(struct Writer *writer, const char *path);
+
+// Appends bytes that are already formatted (e.g. taken from a memory
+// writer of the same format)
+int writer_write(struct Writer *writer, const char *bytes, size_t length);
+
+int writer_flush(struct Writer *writer);
+
+// Hands the buffer of a memory writer over to the caller (free() it), and
+// starts the writer over with an empty one
+int writer_take(struct Writer *writer, char **buffer, size_t *length);
+#endif